@@ -0,0 +1,183 @@
+/**
+ * VorzeControlServer : A VORZE electric toys Vorze A10 Cyclone/Piston SA Remote Control Adapter Server Powered by Boost.Asio
+ * Copyright (C) 2020 Jeremie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "ActionGenerator.h"
+
+#include <charconv>
+#include <limits>
+#include <string>
+
+namespace {
+    std::pair<long long int, bool> parseNumber(std::string_view v) {
+        long long int r = 0;
+        auto e = std::from_chars(v.data(), v.data() + v.size(), r);
+        return {r, e.ec == std::errc{} && e.ptr == v.data() + v.size()};
+    }
+
+    // the longest period/step/flip, so `phase * 256` in ActionGenerator::level() never overflow
+    constexpr long long int MaxDurationMs = std::numeric_limits<long long int>::max() / 256;
+
+    std::pair<long long int, bool> parseDurationMs(std::string_view v) {
+        long long int scale = 1;
+        if (v.size() > 2 && v.substr(v.size() - 2) == "ms") {
+            v.remove_suffix(2);
+        } else if (!v.empty() && v.back() == 's') {
+            v.remove_suffix(1);
+            scale = 1000;
+        } else if (!v.empty() && v.back() == 'm') {
+            v.remove_suffix(1);
+            scale = 60 * 1000;
+        }
+        auto r = parseNumber(v);
+        // check before scale, a negative or huge value must not wrap into a valid one
+        if (!r.second || r.first < 0 || r.first > MaxDurationMs / scale) {
+            return {0, false};
+        }
+        return {r.first * scale, true};
+    }
+
+    /**
+     * a fraction in (0, 1), like `0.25`
+     */
+    std::pair<double, bool> parseFraction(std::string_view v) {
+        if (v.substr(0, 2) != "0." || v.size() == 2 || v.size() > 8) {
+            return {0, false};
+        }
+        auto r = parseNumber(v.substr(2));
+        if (!r.second) {
+            return {0, false};
+        }
+        double d = static_cast<double>(r.first);
+        for (std::size_t i = 2; i != v.size(); ++i) {
+            d /= 10;
+        }
+        return {d, d > 0};
+    }
+}
+
+bool ActionGenerator::isGeneratorMode(std::string_view mode) {
+    auto kind = mode.substr(0, mode.find(':'));
+    return kind == "sine" || kind == "ramp" || kind == "pulse" || kind == "random";
+}
+
+std::pair<ActionGenerator, error_info> ActionGenerator::parse(std::string_view mode, bool direct) {
+    ActionGenerator g;
+    g.direct = direct ? 1 : 0;
+
+    auto colon = mode.find(':');
+    auto kind = mode.substr(0, colon);
+    if (kind == "sine") {
+        g.kind = Kind::sine;
+    } else if (kind == "ramp") {
+        g.kind = Kind::ramp;
+    } else if (kind == "pulse") {
+        g.kind = Kind::pulse;
+    } else if (kind == "random") {
+        g.kind = Kind::random;
+    } else {
+        return {g, error_info{"ActionGenerator unknown kind : " + std::string{kind}}};
+    }
+
+    auto params = colon == std::string_view::npos ? std::string_view{} : mode.substr(colon + 1);
+    while (!params.empty()) {
+        auto comma = params.find(',');
+        auto kv = params.substr(0, comma);
+        params = comma == std::string_view::npos ? std::string_view{} : params.substr(comma + 1);
+        if (kv.empty()) {
+            continue;
+        }
+        auto eq = kv.find('=');
+        if (eq == std::string_view::npos) {
+            return {g, error_info{"ActionGenerator bad param : " + std::string{kv}}};
+        }
+        auto k = kv.substr(0, eq);
+        auto v = kv.substr(eq + 1);
+        bool ok = false;
+        if (k == "period") {
+            auto r = parseDurationMs(v);
+            ok = r.second && r.first > 0;
+            g.periodMs = r.first;
+        } else if (k == "step") {
+            auto r = parseDurationMs(v);
+            ok = r.second && r.first > 0;
+            g.stepMs = r.first;
+        } else if (k == "flip") {
+            auto r = parseDurationMs(v);
+            ok = r.second;
+            g.flipMs = r.first;
+        } else if (k == "min" || k == "max") {
+            auto r = parseNumber(v);
+            ok = r.second && r.first >= 0 && r.first <= 100;
+            (k == "min" ? g.minSpeed : g.maxSpeed) = static_cast<uint8_t>(r.first);
+        } else if (k == "duty") {
+            auto r = parseFraction(v);
+            ok = r.second;
+            g.duty = r.first;
+        } else if (k == "seed") {
+            auto r = parseNumber(v);
+            ok = r.second;
+            g.seed = static_cast<uint64_t>(r.first);
+        }
+        if (!ok) {
+            return {g, error_info{"ActionGenerator bad param : " + std::string{kv}}};
+        }
+    }
+    if (g.minSpeed > g.maxSpeed) {
+        std::swap(g.minSpeed, g.maxSpeed);
+    }
+    return {g, {}};
+}
+
+unsigned ActionGenerator::level(long long int positionMs) const {
+    // periodMs <= MaxDurationMs, so phase * 256 fit
+    auto phase = positionMs % periodMs;
+    switch (kind) {
+        case Kind::sine:
+            return ActionGeneratorDetail::SineTable[static_cast<std::size_t>(phase * 256 / periodMs)];
+        case Kind::ramp:
+            return static_cast<unsigned>(phase * 256 / periodMs);
+        case Kind::pulse:
+            return static_cast<double>(phase) < duty * static_cast<double>(periodMs) ? 255 : 0;
+        case Kind::random: {
+            // walk between the random waypoints, a waypoint every period
+            auto k = static_cast<uint64_t>(positionMs / periodMs);
+            auto a = ActionGeneratorDetail::hash(seed ^ k) & 0xFF;
+            auto b = ActionGeneratorDetail::hash(seed ^ (k + 1)) & 0xFF;
+            return static_cast<unsigned>((a * static_cast<uint64_t>(periodMs - phase) +
+                                          b * static_cast<uint64_t>(phase)) / static_cast<uint64_t>(periodMs));
+        }
+    }
+    return 0;
+}
+
+ActionItem ActionGenerator::at(long long int positionMs) const {
+    if (positionMs < 0) {
+        positionMs = 0;
+    }
+    // hold the state in a step
+    auto stepBegin = positionMs / stepMs * stepMs;
+    auto l = std::min(level(stepBegin), 255u);
+
+    ActionItem a;
+    a.speed = static_cast<uint8_t>(minSpeed + (static_cast<unsigned>(maxSpeed - minSpeed) * l + 127) / 255);
+    a.direct = direct;
+    if (flipMs > 0 && (stepBegin / flipMs) % 2 == 1) {
+        a.direct ^= 1;
+    }
+    return a;
+}
@@ -0,0 +1,164 @@
+/**
+ * VorzeControlServer : A VORZE electric toys Vorze A10 Cyclone/Piston SA Remote Control Adapter Server Powered by Boost.Asio
+ * Copyright (C) 2020 Jeremie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VORZECONTROLSERVER_ACTIONGENERATOR_H
+#define VORZECONTROLSERVER_ACTIONGENERATOR_H
+
+#ifdef MSVC
+#pragma once
+#endif
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include "ActionInfo.h"
+#include "error_info.h"
+
+namespace ActionGeneratorDetail {
+
+    constexpr double Pi = 3.14159265358979323846;
+
+    /**
+     * std::sin is not constexpr, the Taylor series is enough for a 8 bit table
+     */
+    constexpr double constexprSin(double x) {
+        while (x > Pi) {
+            x -= 2 * Pi;
+        }
+        while (x < -Pi) {
+            x += 2 * Pi;
+        }
+        double term = x;
+        double sum = x;
+        for (int n = 1; n != 12; ++n) {
+            term *= -x * x / ((2 * n) * (2 * n + 1));
+            sum += term;
+        }
+        return sum;
+    }
+
+    constexpr std::array<uint8_t, 256> makeSineTable() {
+        std::array<uint8_t, 256> t{};
+        for (std::size_t i = 0; i != t.size(); ++i) {
+            auto v = (constexprSin(2 * Pi * static_cast<double>(i) / 256.0) + 1.0) / 2.0 * 255.0;
+            t[i] = static_cast<uint8_t>(v + 0.5);
+        }
+        return t;
+    }
+
+    /**
+     * one period of sine, 0 ~ 255, start from the middle and go up
+     */
+    inline constexpr std::array<uint8_t, 256> SineTable = makeSineTable();
+
+    static_assert(SineTable[0] == 128 && SineTable[64] == 255 && SineTable[192] == 0,
+                  "SineTable wrong");
+
+    /**
+     * splitmix64, a stateless hash, so the random mode can be evaluated at any time
+     */
+    constexpr uint64_t hash(uint64_t x) {
+        x += 0x9E3779B97F4A7C15ULL;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+        return x ^ (x >> 31);
+    }
+}
+
+/**
+ * a procedural mode, it is evaluated on demand at the playback position, never materialized into ops,
+ *      so a session of it take constant memory however long it run.
+ *
+ *      the mode string is `kind:key=value,key=value`, e.g. `sine:period=4s,min=20,max=90`
+ *          kind    sine | ramp | pulse | random
+ *          period  the waveform period (random : the time between 2 random waypoint), default 4s
+ *          min     the min speed, default 0
+ *          max     the max speed, default 100
+ *          step    the time the state hold, the output change only on the step boundary, default 100ms
+ *          duty    the high part of pulse, in (0, 1), default 0.5
+ *          flip    flip the direction every this time, 0 means never, default 0
+ *          seed    the random seed, default 0
+ *      the time value accept the unit ms/s/m, a bare number is ms.
+ */
+class ActionGenerator {
+public:
+    enum class Kind : uint8_t {
+        sine,
+        ramp,
+        pulse,
+        random,
+    };
+
+private:
+    Kind kind = Kind::sine;
+    long long int periodMs = 4000;
+    long long int stepMs = 100;
+    long long int flipMs = 0;
+    double duty = 0.5;
+    uint8_t minSpeed = 0;
+    uint8_t maxSpeed = 100;
+    uint8_t direct = 0;
+    uint64_t seed = 0;
+
+public:
+    /**
+     * @return true if the mode name is a generator mode (it may still be a bad one)
+     */
+    static bool isGeneratorMode(std::string_view mode);
+
+    /**
+     * @param direct    the direction at the begin
+     */
+    static std::pair<ActionGenerator, error_info> parse(std::string_view mode, bool direct = false);
+
+    /**
+     * the state at the position, its timeTick is meaningless
+     */
+    [[nodiscard]]
+    ActionItem at(long long int positionMs) const;
+
+    /**
+     * @return the position that the next step begin, the state may change there
+     */
+    [[nodiscard]]
+    long long int nextChangeMs(long long int positionMs) const {
+        if (positionMs < 0) {
+            return 0;
+        }
+        return (positionMs / stepMs + 1) * stepMs;
+    }
+
+    [[nodiscard]]
+    Kind getKind() const {
+        return kind;
+    }
+
+private:
+    /**
+     * the level of the waveform in [0, 255] at the position
+     */
+    [[nodiscard]]
+    unsigned level(long long int positionMs) const;
+};
+
+static_assert(sizeof(ActionGenerator) <= 64, "a ActionGenerator must stay small, it is copied into every session");
+
+
+#endif //VORZECONTROLSERVER_ACTIONGENERATOR_H
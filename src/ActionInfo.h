@@ -0,0 +1,297 @@
+/**
+ * VorzeControlServer : A VORZE electric toys Vorze A10 Cyclone/Piston SA Remote Control Adapter Server Powered by Boost.Asio
+ * Copyright (C) 2020 Jeremie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VORZECONTROLSERVER_ACTIONINFO_H
+#define VORZECONTROLSERVER_ACTIONINFO_H
+
+#ifdef MSVC
+#pragma once
+#endif
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * we are operate in hardware, so we must use `steady_clock`, not `system_clock`
+ * steady_clock is a monotonic clock, it never decrease , always moves forward
+ */
+using ActionTimeClock = std::chrono::steady_clock;
+using ActionTimePoint = std::chrono::time_point<ActionTimeClock>;
+using ActionTimeDuration = std::chrono::milliseconds;
+constexpr long long int ActionDurationPerTick = 1000;
+
+
+template<class T>
+ActionTimeDuration ActionTimeDuration_cast(T d) {
+    return std::chrono::duration_cast<ActionTimeDuration>(d);
+}
+
+inline
+ActionTimePoint getActionTimePointNow() {
+    return ActionTimeClock::now();
+}
+
+
+/**
+ * the layout is fixed (8 byte, no padding hole), it is the record layout of the binary pattern library too,
+ * so a mapped library can be viewed as `const ActionItem *` directly.
+ */
+struct ActionItem {
+    uint8_t direct = 0;
+    uint8_t speed = 0;
+    uint16_t reserved = 0;
+    /**
+     * the timeTick means : when this ActionItem end.
+     *      the tick is a time tick, start from first item.
+     *      the tick of first item is how the first item long.
+     *      the tick of last item is how the all item long.
+     */
+    uint32_t timeTick = 0;
+
+    /**
+     * for sort algorithm
+     */
+    bool operator<(const ActionItem &o) const {
+        return this->timeTick < o.timeTick;
+    }
+
+    static ActionItem createTimeTickObject(uint32_t timeTick) {
+        ActionItem a;
+        a.timeTick = timeTick;
+        return a;
+    }
+};
+
+static_assert(sizeof(ActionItem) == 8 && std::is_standard_layout_v<ActionItem>,
+              "ActionItem layout is the binary pattern library record layout, it must not change");
+
+/**
+ * the ops of a ActionInfo.
+ *      it either own the items (load from text or build in memory),
+ *      or is a zero-copy view into a external storage (e.g. a mapped binary library) that it keep alive.
+ */
+class ActionItemList {
+    std::vector<ActionItem> owned;
+    const ActionItem *first = nullptr;
+    std::size_t count = 0;
+    std::shared_ptr<const void> storage;
+
+public:
+    using value_type = ActionItem;
+    using const_iterator = const ActionItem *;
+    using iterator = const_iterator;
+
+    ActionItemList() = default;
+
+    ActionItemList(std::vector<ActionItem> items) : owned(std::move(items)) {
+        first = owned.data();
+        count = owned.size();
+    }
+
+    static ActionItemList view(const ActionItem *first, std::size_t count, std::shared_ptr<const void> storage) {
+        ActionItemList l;
+        l.first = first;
+        l.count = count;
+        l.storage = std::move(storage);
+        return l;
+    }
+
+    ActionItemList(const ActionItemList &o) : owned(o.owned), count(o.count), storage(o.storage) {
+        first = o.isView() ? o.first : owned.data();
+    }
+
+    ActionItemList(ActionItemList &&o) noexcept
+            : owned(std::move(o.owned)), first(o.first), count(o.count), storage(std::move(o.storage)) {
+        // a moved vector keep its buffer, so `first` still valid
+        o.first = nullptr;
+        o.count = 0;
+    }
+
+    ActionItemList &operator=(ActionItemList o) noexcept {
+        owned.swap(o.owned);
+        std::swap(first, o.first);
+        std::swap(count, o.count);
+        storage.swap(o.storage);
+        return *this;
+    }
+
+    [[nodiscard]]
+    bool isView() const {
+        return owned.empty() && first != nullptr;
+    }
+
+    [[nodiscard]]
+    const_iterator begin() const {
+        return first;
+    }
+
+    [[nodiscard]]
+    const_iterator end() const {
+        return first + count;
+    }
+
+    [[nodiscard]]
+    std::size_t size() const {
+        return count;
+    }
+
+    [[nodiscard]]
+    bool empty() const {
+        return count == 0;
+    }
+
+    [[nodiscard]]
+    const ActionItem &operator[](std::size_t i) const {
+        return first[i];
+    }
+
+    [[nodiscard]]
+    const ActionItem &front() const {
+        return first[0];
+    }
+
+    [[nodiscard]]
+    const ActionItem &back() const {
+        return first[count - 1];
+    }
+
+    [[nodiscard]]
+    const ActionItem *data() const {
+        return first;
+    }
+};
+
+/**
+ * @return true if some adjacent items have same direct and speed
+ */
+inline bool hasActionItemRuns(const ActionItemList &ops) {
+    for (std::size_t i = 1; i < ops.size(); ++i) {
+        if (ops[i].direct == ops[i - 1].direct && ops[i].speed == ops[i - 1].speed) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * merge every run of same direct and speed into one item, it keep the timeTick (the end) of the run last item.
+ *      so the playback only see the real state change.
+ * @return how many item was dropped
+ */
+inline std::size_t mergeActionItemRuns(std::vector<ActionItem> &items) {
+    if (items.empty()) {
+        return 0;
+    }
+    std::size_t last = 0;
+    for (std::size_t i = 1; i != items.size(); ++i) {
+        if (items[i].direct == items[last].direct && items[i].speed == items[last].speed) {
+            items[last].timeTick = items[i].timeTick;
+        } else {
+            items[++last] = items[i];
+        }
+    }
+    auto dropped = items.size() - (last + 1);
+    items.resize(last + 1);
+    return dropped;
+}
+
+/**
+ * build a ops list in time order, for the pattern compilers.
+ *      a item that same state as the previous one is merged into it,
+ *      a item that end not after the previous one (shorter than a tick after round) is dropped.
+ */
+class ActionItemBuilder {
+    std::vector<ActionItem> items;
+    std::size_t merged = 0;
+
+public:
+    /**
+     * @return false if the endTick out of the timeTick range
+     */
+    bool append(uint8_t direct, uint8_t speed, long long int endTick) {
+        if (endTick > static_cast<long long int>(UINT32_MAX)) {
+            return false;
+        }
+        if (endTick <= lastTick()) {
+            ++merged;
+            return true;
+        }
+        if (!items.empty() && items.back().direct == direct && items.back().speed == speed) {
+            items.back().timeTick = static_cast<uint32_t>(endTick);
+            ++merged;
+            return true;
+        }
+        ActionItem a;
+        a.direct = direct;
+        a.speed = speed;
+        a.timeTick = static_cast<uint32_t>(endTick);
+        items.push_back(a);
+        return true;
+    }
+
+    [[nodiscard]]
+    long long int lastTick() const {
+        return items.empty() ? 0 : items.back().timeTick;
+    }
+
+    [[nodiscard]]
+    bool empty() const {
+        return items.empty();
+    }
+
+    [[nodiscard]]
+    std::size_t getMerged() const {
+        return merged;
+    }
+
+    std::vector<ActionItem> release() {
+        return std::move(items);
+    }
+};
+
+struct ActionInfo : public std::enable_shared_from_this<ActionInfo> {
+    std::string name;
+    long long int MsPerTick = ActionDurationPerTick;
+    /**
+     * ops must sort by ActionItem::timeTick
+     */
+    ActionItemList ops;
+
+    /**
+     * merge the runs in ops (see mergeActionItemRuns), a view without run keep zero-copy
+     * @return how many item was dropped
+     */
+    std::size_t mergeRuns() {
+        if (!hasActionItemRuns(ops)) {
+            return 0;
+        }
+        std::vector<ActionItem> items{ops.begin(), ops.end()};
+        auto dropped = mergeActionItemRuns(items);
+        ops = ActionItemList{std::move(items)};
+        return dropped;
+    }
+};
+
+
+#endif //VORZECONTROLSERVER_ACTIONINFO_H
@@ -24,118 +24,355 @@
 #endif
 
 #include <boost/asio.hpp>
+#include <boost/filesystem.hpp>
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
 #include <map>
 #include <mutex>
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <optional>
 #include "ConfigLoader.h"
+#include "ActionInfo.h"
+#include "ActionGenerator.h"
+#include "ActionPatternLibrary.h"
+#include "PatternCompiler.h"
+#include "FunscriptConverter.h"
+#include "TimingWheel.h"
+#include "AsyncLogger.h"
+
+using ActionStateCallback = std::function<void(const ActionItem &item)>;
 
 /**
- * we are operate in hardware, so we must use `steady_clock`, not `system_clock`
- * steady_clock is a monotonic clock, it never decrease , always moves forward
+ * the playback of a ActionInfo, or of a ActionGenerator (a procedural mode, evaluated at the position on demand).
+ *      it not poll the action, it schedule the next state change on the shared TimingWheel,
+ *      so it only wake up when the state changed, and a idle session cost nothing.
+ *
+ *      the playback position follow a clock : `position = anchorPosition + (now - anchorTime) * rate`,
+ *      it start from 0 with rate 1, and a external player (e.g. a video) can sync() it.
  */
-using ActionTimeClock = std::chrono::steady_clock;
-using ActionTimePoint = std::chrono::time_point<ActionTimeClock>;
-using ActionTimeDuration = std::chrono::milliseconds;
-constexpr long long int ActionDurationPerTick = 1000;
+class ActionSession : public std::enable_shared_from_this<ActionSession> {
+public:
+    /**
+     * the item count of a seek block, the seek binary search the block end first, then walk in one block
+     */
+    static constexpr std::size_t SeekBlockSize = 64;
 
+private:
+    boost::asio::executor ex;
 
-template<class T>
-ActionTimeDuration ActionTimeDuration_cast(T d) {
-    return std::chrono::duration_cast<ActionTimeDuration>(d);
-}
+    std::shared_ptr<ActionInfo> action;
+    // the timeTick of every block last item, a small dense array, so the seek not touch the whole (maybe mapped) ops
+    std::vector<uint32_t> blockEnds;
+    // set on a procedural mode, the `action` is empty then
+    std::optional<ActionGenerator> generator;
+
+    // the state below only touch them in the executor of timingWheel
+    std::shared_ptr<TimingWheel> timingWheel;
+    ActionStateCallback stateCallback;
+    // how many ms the frame need to take effect, the state is decided that much early
+    std::function<double()> outputLatency;
+    TimingWheelHandle nextChange;
+    bool running = false;
+
+    // the playback cursor, the index of current item in `action->ops`, and which loop it in
+    std::size_t cursor = 0;
+    long long int cursorLoop = 0;
+
+    // the playback clock
+    ActionTimePoint anchorTime;
+    double anchorPositionMs = 0;
+    double rate = 1;
+    // a small drift is absorbed by run at slewRate until slewUntil, instead of jump
+    double slewRate = 1;
+    ActionTimePoint slewUntil;
+
+    // a drift bigger than it (or a rate change) seek directly
+    double seekThresholdMs = 200;
+    double slewMs = 1000;
+
+    std::atomic_size_t syncs{0};
+    std::atomic_size_t seeks{0};
+    std::atomic<double> lastDriftMs{0};
 
-inline
-ActionTimePoint getActionTimePointNow() {
-    return ActionTimeClock::now();
-}
+public:
+    ActionSession(
+            boost::asio::executor ex,
+            std::shared_ptr<ActionInfo> action,
+            std::shared_ptr<TimingWheel> timingWheel
+    ) : ex(ex),
+        action(action),
+        timingWheel(timingWheel),
+        anchorTime(getActionTimePointNow()),
+        slewUntil(anchorTime) {
+        const auto &ops = action->ops;
+        blockEnds.reserve(ops.size() / SeekBlockSize + 1);
+        for (std::size_t i = SeekBlockSize; i < ops.size(); i += SeekBlockSize) {
+            blockEnds.push_back(ops[i - 1].timeTick);
+        }
+        if (!ops.empty()) {
+            blockEnds.push_back(ops.back().timeTick);
+        }
+    }
 
+    ActionSession(
+            boost::asio::executor ex,
+            const ActionGenerator &generator,
+            std::shared_ptr<TimingWheel> timingWheel
+    ) : ex(ex),
+        generator(generator),
+        timingWheel(timingWheel),
+        anchorTime(getActionTimePointNow()),
+        slewUntil(anchorTime) {}
 
-struct ActionItem {
-    uint8_t direct;
-    uint8_t speed;
     /**
-     * the timeTick means : when this ActionItem end.
-     *      the tick is a time tick, start from first item.
-     *      the tick of first item is how the first item long.
-     *      the tick of last item is how the all item long.
+     * @param seekThresholdMs   a drift bigger than it seek directly, a smaller one is slewed
+     * @param slewMs            the time that a small drift is absorbed in
      */
-    size_t timeTick;
+    void setSyncOptions(double seekThresholdMs, double slewMs) {
+        boost::asio::dispatch(timingWheel->getExecutor(), [self = shared_from_this(), this, seekThresholdMs, slewMs]() {
+            this->seekThresholdMs = seekThresholdMs > 0 ? seekThresholdMs : 0;
+            this->slewMs = slewMs > 1 ? slewMs : 1;
+        });
+    }
 
     /**
-     * for sort algorithm
+     * call the callback with the current item now, then call it again on every state change, until stop().
+     *      the callback called in the executor of timingWheel.
+     *
+     * @param outputLatency     query on every state change, the callback is called that ms early (latency compensate)
      */
-    bool operator<(const ActionItem &o) const {
-        return this->timeTick < o.timeTick;
+    void start(ActionStateCallback callback, std::function<double()> outputLatency = {}) {
+        boost::asio::dispatch(timingWheel->getExecutor(), [self = shared_from_this(), this, callback, outputLatency]() {
+            timingWheel->cancel(nextChange);
+            stateCallback = callback;
+            this->outputLatency = outputLatency;
+            running = true;
+            onStateChange();
+        });
     }
 
-    static ActionItem createTimeTickObject(size_t timeTick) {
-        ActionItem a;
-        a.timeTick = timeTick;
-        return a;
+    /**
+     * @param then  called in the executor of timingWheel after stopped, no more state change after it
+     */
+    void stop(const std::function<void()> &then = {}) {
+        boost::asio::dispatch(timingWheel->getExecutor(), [self = shared_from_this(), this, then]() {
+            running = false;
+            timingWheel->cancel(nextChange);
+            stateCallback = nullptr;
+            outputLatency = nullptr;
+            if (then) {
+                then();
+            }
+        });
     }
-};
 
-struct ActionInfo : public std::enable_shared_from_this<ActionInfo> {
-    std::string name;
-    long long int MsPerTick = ActionDurationPerTick;
     /**
-     * ops must sort by ActionItem::timeTick
+     * follow the external player clock.
+     *      a rate change, a pause/resume, or a drift bigger than seekThresholdMs seek to the position directly,
+     *      a smaller drift is slewed : run a little faster or slower until it absorbed, so the state not jump.
+     *
+     * @param positionMs    the player position now
+     * @param rate          the player rate, 0 means paused (the device stop until resume)
      */
-    std::vector<ActionItem> ops;
-};
+    void sync(double positionMs, double rate) {
+        boost::asio::dispatch(timingWheel->getExecutor(), [self = shared_from_this(), this, positionMs, rate]() {
+            auto now = getActionTimePointNow();
+            auto newRate = rate > 0 ? rate : 0;
+            auto local = positionAt(now);
+            auto drift = positionMs - local;
+            syncs.fetch_add(1, std::memory_order_relaxed);
+            lastDriftMs.store(drift, std::memory_order_relaxed);
+
+            if (newRate != this->rate || newRate == 0 || std::abs(drift) > seekThresholdMs) {
+                anchorTime = now;
+                anchorPositionMs = positionMs > 0 ? positionMs : 0;
+                this->rate = newRate;
+                slewRate = newRate;
+                slewUntil = now;
+                seek(ActionTimeDuration{static_cast<ActionTimeDuration::rep>(anchorPositionMs)});
+                seeks.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                // continue from the local position, catch up the drift in slewMs
+                anchorTime = now;
+                anchorPositionMs = local;
+                // a drift just under the threshold with a short slewMs must not run backward or race
+                slewRate = std::clamp(newRate + drift / slewMs, newRate * 0.5, newRate * 2);
+                slewUntil = now + std::chrono::microseconds{static_cast<long long int>(slewMs * 1000)};
+            }
+
+            if (running) {
+                timingWheel->cancel(nextChange);
+                onStateChange();
+            }
+        });
+    }
 
-class ActionSession : public std::enable_shared_from_this<ActionSession> {
-    boost::asio::executor ex;
+    [[nodiscard]]
+    std::size_t getSyncs() const {
+        return syncs.load(std::memory_order_relaxed);
+    }
 
-    std::shared_ptr<ActionInfo> action;
-    const ActionTimePoint initTime;
+    [[nodiscard]]
+    std::size_t getSeeks() const {
+        return seeks.load(std::memory_order_relaxed);
+    }
 
-public:
-    ActionSession(
-            boost::asio::executor ex,
-            std::shared_ptr<ActionInfo> action
-    ) : ex(ex),
-        action(action),
-        initTime(getActionTimePointNow()) {}
+    /**
+     * @return the (player - session) position difference on the last sync
+     */
+    [[nodiscard]]
+    double getLastDriftMs() const {
+        return lastDriftMs.load(std::memory_order_relaxed);
+    }
 
-    auto getNowAction() {
-        auto dt = ActionTimeDuration_cast(getActionTimePointNow() - initTime);
-        if (dt.count() < 0) {
-            // never into there
-            // if into there, means the ActionTimeClock was decrease. this must be never happened.
-            throw std::exception("ActionSession::getNowAction() error : (dt.count() < 0)");
+private:
+    [[nodiscard]]
+    double positionAt(ActionTimePoint now) const {
+        using ms = std::chrono::duration<double, std::milli>;
+        auto elapsed = std::chrono::duration_cast<ms>(now - anchorTime).count();
+        if (now < slewUntil) {
+            return anchorPositionMs + elapsed * slewRate;
         }
+        auto slewed = slewUntil > anchorTime ? std::chrono::duration_cast<ms>(slewUntil - anchorTime).count() : 0.0;
+        return anchorPositionMs + slewed * slewRate + (elapsed - slewed) * rate;
+    }
 
-        // calc tick
-        auto tick = (dt.count() / action->MsPerTick) % action->ops.back().timeTick;
+    void onStateChange() {
+        if (!running) {
+            return;
+        }
+        auto now = getActionTimePointNow();
+        auto effectiveRate = now < slewUntil ? slewRate : rate;
+        auto position = positionAt(now);
+        if (outputLatency && effectiveRate > 0) {
+            // the frame send now take effect after the output latency, so play the state of that time
+            position += std::max(outputLatency(), 0.0) * effectiveRate;
+        }
+        auto dt = ActionTimeDuration{static_cast<ActionTimeDuration::rep>(position > 0 ? position : 0)};
+        auto item = getActionAt(dt);
+
+        if (effectiveRate <= 0) {
+            // paused, stop the device and wait the next sync
+            if (stateCallback) {
+                ActionItem stopped = item;
+                stopped.speed = 0;
+                stateCallback(stopped);
+            }
+            return;
+        }
+
+        // the position time to the end of current item
+        long long int remain = 0;
+        if (generator) {
+            remain = generator->nextChangeMs(dt.count()) - dt.count();
+        } else {
+            auto msPerTick = action->MsPerTick;
+            auto tick = (dt.count() / msPerTick) % action->ops.back().timeTick;
+            remain = (static_cast<long long int>(item.timeTick) - tick) * msPerTick - dt.count() % msPerTick;
+        }
+
+        // to the wall clock, and wake up on the slew end too, the rate change there
+        auto wait = static_cast<double>(remain) / effectiveRate;
+        if (now < slewUntil) {
+            using ms = std::chrono::duration<double, std::milli>;
+            wait = std::min(wait, std::chrono::duration_cast<ms>(slewUntil - now).count());
+        }
 
-        // find the first item that timeTick bigger than tick
-        // way 1
-        auto nIt = std::upper_bound(action->ops.begin(), action->ops.end(),
-                                    ActionItem::createTimeTickObject(tick));
+        if (stateCallback) {
+            stateCallback(item);
+        }
+        nextChange = timingWheel->schedule(
+                std::chrono::milliseconds{static_cast<std::chrono::milliseconds::rep>(std::ceil(wait))},
+                [self = shared_from_this()]() {
+                    self->onStateChange();
+                });
+    }
 
-        // way 2
-        // size_t index = 0;
-        // for (; index != action->ops.size(); ++index) {
-        //     auto n = action->ops.at(index);
-        //     if (n.timeTick > tick) {
-        //         break;
-        //     }
-        // }
-        // auto nIt2 = action->ops.begin();
-        // std::advance(nIt2, index);
+public:
+    /**
+     * the item at the playback position now
+     */
+    ActionItem getNowAction() {
+        auto position = positionAt(getActionTimePointNow());
+        return getActionAt(ActionTimeDuration{static_cast<ActionTimeDuration::rep>(position > 0 ? position : 0)});
+    }
+
+    /**
+     * the item at the position `dt` of the pattern.
+     *      the playback only move forward, so it walk a cursor from the last position, amortized O(1),
+     *      and a loop wrap reset the cursor to the begin without search.
+     *      a backward, a more than one loop, or a more than one block jump fall back to seek().
+     *
+     * NOTE: it is stateful, call it in one thread (the executor of timingWheel) only.
+     */
+    ActionItem getActionAt(ActionTimeDuration dt) {
+        if (generator) {
+            return generator->at(dt.count());
+        }
+        const auto &ops = action->ops;
+        const auto totalTick = static_cast<long long int>(ops.back().timeTick);
+        if (dt.count() < 0 || totalTick <= 0) {
+            // the position never negative, and a empty pattern never create a session,
+            // but not throw from the timer callback, just play the begin
+            return ops.front();
+        }
 
-        if (nIt == action->ops.end()) {
-            // never into there
-            // if into there, means the `tick` calc wrong.
-            throw std::exception("ActionSession::getNowAction() error : (nIt == action->ops.end())");
+        auto allTick = dt.count() / action->MsPerTick;
+        auto loop = allTick / totalTick;
+        auto tick = allTick % totalTick;
+
+        if (loop == cursorLoop + 1) {
+            // wrap around
+            cursor = 0;
+            cursorLoop = loop;
+        } else if (loop != cursorLoop ||
+                   (cursor != 0 && static_cast<long long int>(ops[cursor - 1].timeTick) > tick)) {
+            return seek(dt);
         }
 
-        return *nIt;
+        // the tick always less than ops.back().timeTick, so it never run out of the end
+        for (std::size_t step = 0; static_cast<long long int>(ops[cursor].timeTick) <= tick; ++step) {
+            if (step == SeekBlockSize) {
+                // a long forward jump
+                return seek(dt);
+            }
+            ++cursor;
+        }
+        return ops[cursor];
+    }
 
+    /**
+     * move the cursor to `dt`, O(log n) : binary search the block, then walk in the block
+     */
+    ActionItem seek(ActionTimeDuration dt) {
+        if (generator) {
+            // stateless, nothing to move
+            return generator->at(dt.count());
+        }
+        const auto &ops = action->ops;
+        const auto totalTick = static_cast<long long int>(ops.back().timeTick);
+        if (dt.count() < 0 || totalTick <= 0) {
+            cursor = 0;
+            cursorLoop = 0;
+            return ops.front();
+        }
+        auto allTick = dt.count() / action->MsPerTick;
+        auto tick = static_cast<uint32_t>(allTick % totalTick);
+
+        // the first block that end after tick, then the first item in it that timeTick bigger than tick
+        auto block = static_cast<std::size_t>(
+                std::upper_bound(blockEnds.begin(), blockEnds.end(), tick) - blockEnds.begin());
+        auto i = block * SeekBlockSize;
+        while (ops[i].timeTick <= tick) {
+            ++i;
+        }
+        cursor = i;
+        cursorLoop = allTick / totalTick;
+        return ops[cursor];
     }
 
 };
@@ -146,31 +383,114 @@ class ActionModeManager : public std::enable_shared_from_this<ActionModeManager>
     std::map<std::string, std::shared_ptr<ActionInfo>> actionLib;
     std::mutex actionLibMtx;
 
+    // the mapped binary pattern library, the pattern in it is materialized on the first use
+    std::shared_ptr<ActionPatternLibrary> actionPatternLibrary;
+
+    // all the ActionSession share it
+    std::shared_ptr<TimingWheel> timingWheel;
+
 public:
     ActionModeManager(
-            std::shared_ptr<ConfigLoader> configLoader
-    ) : configLoader(configLoader) {}
+            std::shared_ptr<ConfigLoader> configLoader,
+            std::shared_ptr<TimingWheel> timingWheel
+    ) : configLoader(configLoader),
+        timingWheel(timingWheel) {}
+
+    [[nodiscard]]
+    std::shared_ptr<TimingWheel> getTimingWheel() const {
+        return timingWheel;
+    }
 
     void loadActionFromConfig() {
         std::map<std::string, std::shared_ptr<ActionInfo>> actionLibTemp;
-        // TODO load actionLib from file
+        std::shared_ptr<ActionPatternLibrary> actionPatternLibraryTemp;
+
+        const auto &libraryPath = configLoader->config.actionLibraryPath;
+        if (!libraryPath.empty()) {
+            auto r = ActionPatternLibrary::open(libraryPath);
+            if (r.second) {
+                LOG_ERROR << r.second.message();
+            } else {
+                actionPatternLibraryTemp = r.first;
+                LOG_INFO << "ActionModeManager load " << actionPatternLibraryTemp->size()
+                         << " pattern from " << libraryPath;
+            }
+        }
 
+        const auto &scriptDir = configLoader->config.actionScriptDir;
+        if (!scriptDir.empty()) {
+            boost::system::error_code ec;
+            for (boost::filesystem::directory_iterator it{scriptDir, ec}, end; !ec && it != end; it.increment(ec)) {
+                auto ext = it->path().extension().string();
+                std::pair<std::shared_ptr<ActionInfo>, error_info> r;
+                if (ext == ".txt" || ext == ".csv") {
+                    r = PatternCompiler::compileFile(it->path().string());
+                } else if (ext == ".funscript") {
+                    FunscriptConvertOptions o;
+                    o.fullSpeedVelocity = configLoader->config.funscriptFullSpeedVelocity;
+                    o.smoothing = configLoader->config.funscriptSmoothing;
+                    o.reversalsPerFlip = configLoader->config.funscriptReversalsPerFlip;
+                    r = FunscriptConverter::convertFile(it->path().string(), o);
+                } else {
+                    continue;
+                }
+                if (r.second) {
+                    LOG_WARNING << r.second.message();
+                    continue;
+                }
+                actionLibTemp[r.first->name] = r.first;
+            }
+            if (ec) {
+                LOG_ERROR << "ActionModeManager cannot read actionScriptDir " << scriptDir
+                          << " : " << ec.message();
+            }
+            LOG_INFO << "ActionModeManager compile " << actionLibTemp.size()
+                     << " pattern from " << scriptDir;
+        }
 
         {
             std::lock_guard lg{actionLibMtx};
             actionLib.clear();
             actionLib = actionLibTemp;
+            actionPatternLibrary = actionPatternLibraryTemp;
         }
     }
 
-    std::shared_ptr<ActionSession> init(const std::string &mode, boost::asio::executor &ex) {
-        std::lock_guard lg{actionLibMtx};
-        auto n = actionLib.find(mode);
-        if (n != actionLib.end()) {
-            return std::make_shared<ActionSession>(ex, n->second);
+    std::shared_ptr<ActionInfo> findAction(const std::string &mode) {
+        std::shared_ptr<ActionPatternLibrary> library;
+        {
+            std::lock_guard lg{actionLibMtx};
+            auto n = actionLib.find(mode);
+            if (n != actionLib.end()) {
+                return n->second;
+            }
+            library = actionPatternLibrary;
+        }
+        return library ? library->find(mode) : std::shared_ptr<ActionInfo>{};
+    }
+
+    /**
+     * @param mode      a pattern name, or a procedural mode like `sine:period=4s,min=20,max=90` (see ActionGenerator)
+     * @param direct    the direction that a procedural mode begin with
+     */
+    std::shared_ptr<ActionSession> init(const std::string &mode, boost::asio::executor &ex, bool direct = true) {
+        std::shared_ptr<ActionSession> s;
+        if (ActionGenerator::isGeneratorMode(mode)) {
+            auto g = ActionGenerator::parse(mode, direct);
+            if (g.second) {
+                LOG_WARNING << g.second.message();
+                return {};
+            }
+            s = std::make_shared<ActionSession>(ex, g.first, timingWheel);
         } else {
-            return {};
+            auto action = findAction(mode);
+            if (!action || action->ops.empty()) {
+                return {};
+            }
+            s = std::make_shared<ActionSession>(ex, action, timingWheel);
         }
+        s->setSyncOptions(configLoader->config.syncSeekThresholdMs, configLoader->config.syncSlewMs);
+        return s;
     }
 
 };
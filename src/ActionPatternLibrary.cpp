@@ -0,0 +1,226 @@
+/**
+ * VorzeControlServer : A VORZE electric toys Vorze A10 Cyclone/Piston SA Remote Control Adapter Server Powered by Boost.Asio
+ * Copyright (C) 2020 Jeremie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "ActionPatternLibrary.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+    constexpr uint64_t alignUp(uint64_t v, uint64_t a) {
+        return (v + a - 1) / a * a;
+    }
+
+    /**
+     * @return true if `count` element of `size` byte from `offset` fit in `limit`,
+     *      in the subtraction form, a hostile offset or count never wrap around
+     */
+    constexpr bool fitsIn(uint64_t offset, uint64_t count, uint64_t size, uint64_t limit) {
+        return offset <= limit && count <= (limit - offset) / size;
+    }
+
+    /**
+     * the playback need the timeTick strictly increase (so the last one is the biggest and not 0),
+     *      a corrupt entry would divide by zero or walk the cursor out of the end
+     */
+    bool isPlayable(const ActionItem *first, std::size_t count) {
+        uint32_t last = 0;
+        for (std::size_t i = 0; i != count; ++i) {
+            if (first[i].timeTick <= last) {
+                return false;
+            }
+            last = first[i].timeTick;
+        }
+        return true;
+    }
+}
+
+std::pair<std::shared_ptr<ActionPatternLibrary>, error_info> ActionPatternLibrary::open(const std::string &path) {
+    auto lib = std::make_shared<ActionPatternLibrary>();
+    try {
+        boost::interprocess::file_mapping fm{path.c_str(), boost::interprocess::read_only};
+        lib->region = std::make_shared<const boost::interprocess::mapped_region>(fm, boost::interprocess::read_only);
+    } catch (const boost::interprocess::interprocess_exception &e) {
+        std::stringstream ss;
+        ss << "ActionPatternLibrary::open() cannot map " << path << " error:" << e.what();
+        return {{}, error_info{ss.str()}};
+    }
+
+    auto base = static_cast<const char *>(lib->region->get_address());
+    auto fileSize = static_cast<uint64_t>(lib->region->get_size());
+    auto bad = [&path](const char *why) {
+        std::stringstream ss;
+        ss << "ActionPatternLibrary::open() bad library " << path << " : " << why;
+        return std::make_pair(std::shared_ptr<ActionPatternLibrary>{}, error_info{ss.str()});
+    };
+
+    if (fileSize < sizeof(ActionPatternLibraryHeader)) {
+        return bad("file too small");
+    }
+    auto h = reinterpret_cast<const ActionPatternLibraryHeader *>(base);
+    if (h->magic != ActionPatternLibraryHeader::Magic) {
+        return bad("magic not match");
+    }
+    if (h->version != ActionPatternLibraryHeader::Version) {
+        return bad("version not support");
+    }
+    if (h->indexOffset % alignof(ActionPatternIndexEntry) != 0 ||
+        !fitsIn(h->indexOffset, h->patternCount, sizeof(ActionPatternIndexEntry), fileSize)) {
+        return bad("index out of range");
+    }
+    if (!fitsIn(h->stringsOffset, h->stringsSize, 1, fileSize)) {
+        return bad("strings out of range");
+    }
+    if (h->recordsOffset % alignof(ActionItem) != 0 ||
+        !fitsIn(h->recordsOffset, h->recordsCount, sizeof(ActionItem), fileSize)) {
+        return bad("records out of range");
+    }
+
+    lib->header = h;
+    lib->index = reinterpret_cast<const ActionPatternIndexEntry *>(base + h->indexOffset);
+    lib->strings = base + h->stringsOffset;
+    lib->records = reinterpret_cast<const ActionItem *>(base + h->recordsOffset);
+    return {lib, error_info{}};
+}
+
+std::shared_ptr<ActionInfo> ActionPatternLibrary::find(std::string_view name) {
+    if (!header) {
+        return {};
+    }
+    {
+        std::lock_guard lg{materializedMtx};
+        auto it = materialized.find(name);
+        if (it != materialized.end()) {
+            return it->second;
+        }
+    }
+
+    auto first = index;
+    auto last = index + header->patternCount;
+    auto it = std::lower_bound(first, last, name, [this](const ActionPatternIndexEntry &e, std::string_view n) {
+        // a broken entry sort as empty name, it never match
+        if (!fitsIn(e.nameOffset, e.nameLength, 1, header->stringsSize)) {
+            return !n.empty();
+        }
+        return nameOf(e) < n;
+    });
+    if (it == last ||
+        !fitsIn(it->nameOffset, it->nameLength, 1, header->stringsSize) ||
+        nameOf(*it) != name) {
+        return {};
+    }
+    if (!fitsIn(it->firstRecord, it->recordCount, 1, header->recordsCount) ||
+        it->recordCount == 0 || it->msPerTick == 0) {
+        std::cerr << "ActionPatternLibrary::find() bad pattern : " << name << std::endl;
+        return {};
+    }
+    if (!isPlayable(records + it->firstRecord, it->recordCount)) {
+        std::cerr << "ActionPatternLibrary::find() pattern timeTick not increase : " << name << std::endl;
+        return {};
+    }
+
+    auto a = std::make_shared<ActionInfo>();
+    a->name = std::string{name};
+    a->MsPerTick = it->msPerTick;
+    a->ops = ActionItemList::view(records + it->firstRecord, it->recordCount, region);
+    // a library not write by write() may have runs, it fall back to a merged copy
+    a->mergeRuns();
+
+    std::lock_guard lg{materializedMtx};
+    return materialized.emplace(a->name, a).first->second;
+}
+
+error_info ActionPatternLibrary::write(const std::string &path, const std::vector<std::shared_ptr<ActionInfo>> &actions) {
+    std::vector<std::shared_ptr<ActionInfo>> sorted;
+    for (const auto &a : actions) {
+        if (!a) {
+            continue;
+        }
+        if (hasActionItemRuns(a->ops)) {
+            // the library only hold the real state change
+            auto m = std::make_shared<ActionInfo>(*a);
+            m->mergeRuns();
+            sorted.push_back(m);
+        } else {
+            sorted.push_back(a);
+        }
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b) {
+        return a->name < b->name;
+    });
+    // find() bisect the index by name, a duplicate name would give any one of them
+    auto dup = std::adjacent_find(sorted.begin(), sorted.end(), [](const auto &a, const auto &b) {
+        return a->name == b->name;
+    });
+    if (dup != sorted.end()) {
+        return error_info{"ActionPatternLibrary::write() duplicate pattern name : " + (*dup)->name};
+    }
+
+    ActionPatternLibraryHeader h{};
+    h.magic = ActionPatternLibraryHeader::Magic;
+    h.version = ActionPatternLibraryHeader::Version;
+    h.patternCount = static_cast<uint32_t>(sorted.size());
+
+    std::vector<ActionPatternIndexEntry> entries;
+    entries.reserve(sorted.size());
+    std::string strings;
+    uint64_t recordsCount = 0;
+    for (const auto &a : sorted) {
+        ActionPatternIndexEntry e{};
+        e.nameOffset = static_cast<uint32_t>(strings.size());
+        e.nameLength = static_cast<uint32_t>(a->name.size());
+        e.firstRecord = recordsCount;
+        e.recordCount = static_cast<uint32_t>(a->ops.size());
+        e.msPerTick = static_cast<uint32_t>(a->MsPerTick);
+        strings += a->name;
+        recordsCount += a->ops.size();
+        entries.push_back(e);
+    }
+
+    h.indexOffset = alignUp(sizeof(ActionPatternLibraryHeader), 8);
+    h.stringsOffset = h.indexOffset + entries.size() * sizeof(ActionPatternIndexEntry);
+    h.stringsSize = strings.size();
+    h.recordsOffset = alignUp(h.stringsOffset + h.stringsSize, 8);
+    h.recordsCount = recordsCount;
+
+    std::ofstream f{path, std::ios::binary | std::ios::trunc};
+    if (!f) {
+        return error_info{"ActionPatternLibrary::write() cannot open " + path};
+    }
+    auto pad = [&f](uint64_t to) {
+        static const char zero[8]{};
+        auto now = static_cast<uint64_t>(f.tellp());
+        f.write(zero, static_cast<std::streamsize>(to - now));
+    };
+    f.write(reinterpret_cast<const char *>(&h), sizeof(h));
+    pad(h.indexOffset);
+    f.write(reinterpret_cast<const char *>(entries.data()),
+            static_cast<std::streamsize>(entries.size() * sizeof(ActionPatternIndexEntry)));
+    f.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+    pad(h.recordsOffset);
+    for (const auto &a : sorted) {
+        f.write(reinterpret_cast<const char *>(a->ops.data()),
+                static_cast<std::streamsize>(a->ops.size() * sizeof(ActionItem)));
+    }
+    if (!f) {
+        return error_info{"ActionPatternLibrary::write() write fail " + path};
+    }
+    return {};
+}
@@ -0,0 +1,118 @@
+/**
+ * VorzeControlServer : A VORZE electric toys Vorze A10 Cyclone/Piston SA Remote Control Adapter Server Powered by Boost.Asio
+ * Copyright (C) 2020 Jeremie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VORZECONTROLSERVER_ACTIONPATTERNLIBRARY_H
+#define VORZECONTROLSERVER_ACTIONPATTERNLIBRARY_H
+
+#ifdef MSVC
+#pragma once
+#endif
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "ActionInfo.h"
+#include "error_info.h"
+
+/**
+ * the binary pattern library file layout (native byte order) :
+ *
+ *      ActionPatternLibraryHeader
+ *      ActionPatternIndexEntry[patternCount]   sorted by name, for binary search
+ *      char strings[stringsSize]               the names, not zero terminated
+ *      ActionItem records[recordsCount]        8 byte aligned, every pattern own a continuous range
+ */
+struct ActionPatternLibraryHeader {
+    static constexpr std::array<char, 4> Magic{'V', 'Z', 'P', 'L'};
+    static constexpr uint32_t Version = 1;
+
+    std::array<char, 4> magic;
+    uint32_t version;
+    uint32_t patternCount;
+    uint32_t reserved;
+    uint64_t indexOffset;
+    uint64_t stringsOffset;
+    uint64_t stringsSize;
+    uint64_t recordsOffset;
+    uint64_t recordsCount;
+};
+
+struct ActionPatternIndexEntry {
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    uint64_t firstRecord;
+    uint32_t recordCount;
+    uint32_t msPerTick;
+};
+
+static_assert(sizeof(ActionPatternLibraryHeader) == 56, "ActionPatternLibraryHeader layout changed");
+static_assert(sizeof(ActionPatternIndexEntry) == 24, "ActionPatternIndexEntry layout changed");
+
+/**
+ * a memory-mapped binary pattern library.
+ *      open() only map the file and check the header, it never walk the patterns,
+ *      so the startup cost not grow with the library size.
+ *      a ActionInfo is materialized on the first find() of its name, its ops is a zero-copy view into the mapping.
+ */
+class ActionPatternLibrary : public std::enable_shared_from_this<ActionPatternLibrary> {
+    std::shared_ptr<const boost::interprocess::mapped_region> region;
+
+    const ActionPatternLibraryHeader *header = nullptr;
+    const ActionPatternIndexEntry *index = nullptr;
+    const char *strings = nullptr;
+    const ActionItem *records = nullptr;
+
+    std::map<std::string, std::shared_ptr<ActionInfo>, std::less<>> materialized;
+    std::mutex materializedMtx;
+
+public:
+    static std::pair<std::shared_ptr<ActionPatternLibrary>, error_info> open(const std::string &path);
+
+    /**
+     * write the actions as a binary pattern library, the `ops` of every action must sort by timeTick,
+     *      the runs of same state are merged before written, the names must be unique
+     */
+    static error_info write(const std::string &path, const std::vector<std::shared_ptr<ActionInfo>> &actions);
+
+    /**
+     * @return empty if not found
+     */
+    std::shared_ptr<ActionInfo> find(std::string_view name);
+
+    [[nodiscard]]
+    std::size_t size() const {
+        return header ? header->patternCount : 0;
+    }
+
+private:
+    [[nodiscard]]
+    std::string_view nameOf(const ActionPatternIndexEntry &e) const {
+        return {strings + e.nameOffset, e.nameLength};
+    }
+};
+
+
+#endif //VORZECONTROLSERVER_ACTIONPATTERNLIBRARY_H
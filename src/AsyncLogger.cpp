@@ -0,0 +1,220 @@
+/**
+ * VorzeControlServer : A VORZE electric toys Vorze A10 Cyclone/Piston SA Remote Control Adapter Server Powered by Boost.Asio
+ * Copyright (C) 2020 Jeremie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "AsyncLogger.h"
+
+#include <algorithm>
+#include <charconv>
+#include <ctime>
+
+LogLevel parseLogLevel(std::string_view name) {
+    if (name == "trace") {
+        return LogLevel::trace;
+    }
+    if (name == "debug") {
+        return LogLevel::debug;
+    }
+    if (name == "warning") {
+        return LogLevel::warning;
+    }
+    if (name == "error") {
+        return LogLevel::error;
+    }
+    if (name == "off") {
+        return LogLevel::off;
+    }
+    return LogLevel::info;
+}
+
+const char *logLevelName(LogLevel level) {
+    switch (level) {
+        case LogLevel::trace:
+            return "trace";
+        case LogLevel::debug:
+            return "debug";
+        case LogLevel::info:
+            return "info";
+        case LogLevel::warning:
+            return "warning";
+        case LogLevel::error:
+            return "error";
+        case LogLevel::off:
+            return "off";
+    }
+    return "";
+}
+
+AsyncLogger::AsyncLogger() {
+    batch.reserve(64 * 1024);
+    writer = std::thread{[this]() {
+        run();
+    }};
+}
+
+AsyncLogger::~AsyncLogger() {
+    stopping.store(true);
+    wakeCv.notify_one();
+    if (writer.joinable()) {
+        writer.join();
+    }
+    flush();
+}
+
+AsyncLogger &AsyncLogger::instance() {
+    static AsyncLogger logger;
+    return logger;
+}
+
+namespace {
+    // retire the ring when the thread exit, so a short-lived thread not leave its ring in the rings forever
+    struct ThreadRingHolder {
+        std::shared_ptr<LogThreadRing> ring;
+
+        ~ThreadRingHolder() {
+            if (ring) {
+                ring->retire();
+            }
+        }
+    };
+}
+
+LogThreadRing &AsyncLogger::threadRing() {
+    thread_local ThreadRingHolder holder;
+    if (!holder.ring) {
+        // once per thread
+        auto r = std::make_shared<LogThreadRing>();
+        std::lock_guard lg{ringsMtx};
+        rings.push_back(r);
+        holder.ring = std::move(r);
+    }
+    return *holder.ring;
+}
+
+void AsyncLogger::push(const LogRecord &r) {
+    auto size = threadRing().tryPush(r);
+    if (r.level >= LogLevel::error || size == LogThreadRing::Capacity / 2) {
+        // not wait the next round for a error, or before the ring full
+        wakeCv.notify_one();
+    }
+}
+
+void AsyncLogger::flush() {
+    std::lock_guard lg{drainMtx};
+    drainAll();
+}
+
+void AsyncLogger::run() {
+    while (!stopping.load()) {
+        {
+            std::unique_lock ul{wakeMtx};
+            wakeCv.wait_for(ul, FlushInterval);
+        }
+        flush();
+    }
+}
+
+void AsyncLogger::drainAll() {
+    std::vector<std::shared_ptr<LogThreadRing>> rs;
+    {
+        std::lock_guard lg{ringsMtx};
+        rs = rings;
+    }
+
+    // the local time of a second is formatted once
+    static thread_local int64_t lastSecond = -1;
+    static thread_local char secondText[32]{};
+
+    std::size_t n = 0;
+    std::size_t lost = 0;
+    std::vector<LogThreadRing *> retired;
+    batch.clear();
+    for (const auto &ring : rs) {
+        // check before drain, so this drain is the last one of a retired ring
+        if (ring->isRetired()) {
+            retired.push_back(ring.get());
+        }
+        lost += ring->takeDropped();
+        n += ring->drain([this](const LogRecord &r) {
+            auto second = r.timeUs / 1000000;
+            if (second != lastSecond) {
+                lastSecond = second;
+                auto t = static_cast<std::time_t>(second);
+                std::tm tm{};
+#ifdef _WIN32
+                localtime_s(&tm, &t);
+#else
+                localtime_r(&t, &tm);
+#endif // _WIN32
+                std::strftime(secondText, sizeof(secondText), "%Y-%m-%d %H:%M:%S", &tm);
+            }
+            char us[16];
+            std::snprintf(us, sizeof(us), ".%06d", static_cast<int>(r.timeUs % 1000000));
+            batch += '[';
+            batch += secondText;
+            batch += us;
+            batch += "] [";
+            batch += logLevelName(r.level);
+            batch += "] ";
+            batch.append(r.text.data(), r.size);
+            if (r.truncated) {
+                batch += "...";
+            }
+            batch += '\n';
+        });
+    }
+    if (!retired.empty()) {
+        std::lock_guard lg{ringsMtx};
+        rings.erase(std::remove_if(rings.begin(), rings.end(), [&retired](const std::shared_ptr<LogThreadRing> &r) {
+            return std::find(retired.begin(), retired.end(), r.get()) != retired.end();
+        }), rings.end());
+    }
+    if (lost != 0) {
+        dropped.fetch_add(lost, std::memory_order_relaxed);
+        batch += "[AsyncLogger] dropped " + std::to_string(lost) + " log lines\n";
+    }
+    if (!batch.empty()) {
+        std::fwrite(batch.data(), 1, batch.size(), out);
+        std::fflush(out);
+        written.fetch_add(n, std::memory_order_relaxed);
+    }
+}
+
+LogLine &LogLine::operator<<(double v) {
+    char buf[32];
+    auto n = std::snprintf(buf, sizeof(buf), "%g", v);
+    if (n > 0) {
+        append(buf, std::min(static_cast<std::size_t>(n), sizeof(buf) - 1));
+    }
+    return *this;
+}
+
+void LogLine::append(const char *p, std::size_t n) {
+    auto room = r.text.size() - r.size;
+    if (n > room) {
+        n = room;
+        r.truncated = true;
+    }
+    std::copy(p, p + n, r.text.data() + r.size);
+    r.size = static_cast<uint16_t>(r.size + n);
+}
+
+void LogLine::appendUnsigned(unsigned long long int v) {
+    char buf[24];
+    auto e = std::to_chars(buf, buf + sizeof(buf), v);
+    append(buf, static_cast<std::size_t>(e.ptr - buf));
+}
@@ -0,0 +1,315 @@
+/**
+ * VorzeControlServer : A VORZE electric toys Vorze A10 Cyclone/Piston SA Remote Control Adapter Server Powered by Boost.Asio
+ * Copyright (C) 2020 Jeremie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VORZECONTROLSERVER_ASYNCLOGGER_H
+#define VORZECONTROLSERVER_ASYNCLOGGER_H
+
+#ifdef MSVC
+#pragma once
+#endif
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+enum class LogLevel : int {
+    trace = 0,
+    debug = 1,
+    info = 2,
+    warning = 3,
+    error = 4,
+    off = 5,
+};
+
+/**
+ * the log level below it is compiled out, set by the build (LOG_COMPILE_LEVEL in CMakeLists)
+ */
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL 0
+#endif // LOG_COMPILE_LEVEL
+
+constexpr LogLevel LogCompileLevel = static_cast<LogLevel>(LOG_COMPILE_LEVEL);
+
+/**
+ * @return LogLevel::info if the name unknown
+ */
+LogLevel parseLogLevel(std::string_view name);
+
+const char *logLevelName(LogLevel level);
+
+/**
+ * a formatted log line, fixed size, so it go into the ring without allocate
+ */
+struct LogRecord {
+    static constexpr std::size_t TextCapacity = 240;
+
+    int64_t timeUs = 0;
+    LogLevel level = LogLevel::info;
+    uint16_t size = 0;
+    bool truncated = false;
+    std::array<char, TextCapacity> text;
+};
+
+/**
+ * a single-producer/single-consumer ring, one per logging thread, the writer thread is the consumer.
+ *      the ring is retired when its thread exit, the writer drop it after the last drain.
+ */
+class LogThreadRing {
+public:
+    static constexpr std::size_t Capacity = 2048;
+    static_assert((Capacity & (Capacity - 1)) == 0, "LogThreadRing Capacity must be power of two");
+
+private:
+    std::array<LogRecord, Capacity> records;
+    alignas(64) std::atomic<std::size_t> head{0};
+    alignas(64) std::atomic<std::size_t> tail{0};
+    alignas(64) std::atomic<std::size_t> dropped{0};
+    std::atomic_bool retired{false};
+
+public:
+    /**
+     * the record is dropped if full, the producer never wait
+     * @return the size after push, 0 if dropped
+     */
+    std::size_t tryPush(const LogRecord &r) {
+        auto t = tail.load(std::memory_order_relaxed);
+        auto size = t - head.load(std::memory_order_acquire);
+        if (size == Capacity) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return 0;
+        }
+        records[t & (Capacity - 1)] = r;
+        tail.store(t + 1, std::memory_order_release);
+        return size + 1;
+    }
+
+    /**
+     * consumer only, call f(const LogRecord &) for every record in the ring
+     * @return how many record consumed
+     */
+    template<typename F>
+    std::size_t drain(F &&f) {
+        auto h = head.load(std::memory_order_relaxed);
+        auto t = tail.load(std::memory_order_acquire);
+        for (auto i = h; i != t; ++i) {
+            f(records[i & (Capacity - 1)]);
+        }
+        head.store(t, std::memory_order_release);
+        return t - h;
+    }
+
+    std::size_t takeDropped() {
+        return dropped.exchange(0, std::memory_order_relaxed);
+    }
+
+    /**
+     * producer only, the last call of it, no push after it
+     */
+    void retire() {
+        retired.store(true, std::memory_order_release);
+    }
+
+    /**
+     * consumer only, if true, a drain after it get all the records left
+     */
+    [[nodiscard]]
+    bool isRetired() const {
+        return retired.load(std::memory_order_acquire);
+    }
+};
+
+/**
+ * the async logger.
+ *      a log line is formatted into a LogRecord in the calling thread, then pushed into the ring of that thread,
+ *      a background writer thread drain all the rings in batch, and write them with one fwrite and flush.
+ *      so the io threads never take a lock or wait the output, a full ring drop the line and count it.
+ *
+ *      the level below LogCompileLevel is compiled out, the level below the runtime level cost one atomic load.
+ */
+class AsyncLogger {
+    std::atomic<LogLevel> level{LogLevel::info};
+
+    std::mutex ringsMtx;
+    std::vector<std::shared_ptr<LogThreadRing>> rings;
+    // the rings have only one consumer at a time
+    std::mutex drainMtx;
+    // the batch output buffer, only touch it under drainMtx
+    std::string batch;
+
+    std::mutex wakeMtx;
+    std::condition_variable wakeCv;
+    std::atomic_bool stopping{false};
+    std::atomic_size_t written{0};
+    std::atomic_size_t dropped{0};
+    std::thread writer;
+
+    FILE *out = stdout;
+
+    // drain the rings every this time, or when a error come, or a ring half full
+    static constexpr std::chrono::milliseconds FlushInterval{50};
+
+    AsyncLogger();
+
+public:
+    ~AsyncLogger();
+
+    AsyncLogger(const AsyncLogger &) = delete;
+
+    AsyncLogger &operator=(const AsyncLogger &) = delete;
+
+    static AsyncLogger &instance();
+
+    void setLevel(LogLevel l) {
+        level.store(l, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]]
+    bool enabled(LogLevel l) const {
+        return l >= level.load(std::memory_order_relaxed) && l != LogLevel::off;
+    }
+
+    /**
+     * called by LogLine, from any thread
+     */
+    void push(const LogRecord &r);
+
+    /**
+     * write out all the pending lines now, e.g. before exit
+     */
+    void flush();
+
+    [[nodiscard]]
+    std::size_t getWritten() const {
+        return written.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]]
+    std::size_t getDropped() const {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    LogThreadRing &threadRing();
+
+    void run();
+
+    // under drainMtx
+    void drainAll();
+};
+
+/**
+ * build a LogRecord with `<<`, push it when destruct. use it by the LOG_* macro only.
+ */
+class LogLine {
+    LogRecord r;
+
+public:
+    explicit LogLine(LogLevel level) {
+        r.level = level;
+        r.timeUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    LogLine(const LogLine &) = delete;
+
+    LogLine &operator=(const LogLine &) = delete;
+
+    ~LogLine() {
+        AsyncLogger::instance().push(r);
+    }
+
+    LogLine &operator<<(std::string_view s) {
+        append(s.data(), s.size());
+        return *this;
+    }
+
+    LogLine &operator<<(const char *s) {
+        return *this << std::string_view{s};
+    }
+
+    LogLine &operator<<(const std::string &s) {
+        return *this << std::string_view{s};
+    }
+
+    LogLine &operator<<(char c) {
+        append(&c, 1);
+        return *this;
+    }
+
+    LogLine &operator<<(bool b) {
+        return *this << (b ? "true" : "false");
+    }
+
+    template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
+    LogLine &operator<<(T v) {
+        if constexpr (std::is_signed_v<T>) {
+            if (v < 0) {
+                append("-", 1);
+                appendUnsigned(0ULL - static_cast<unsigned long long int>(v));
+                return *this;
+            }
+        }
+        appendUnsigned(static_cast<unsigned long long int>(v));
+        return *this;
+    }
+
+    LogLine &operator<<(double v);
+
+    /**
+     * a string-like (e.g. boost::string_view of beast)
+     */
+    template<typename T, std::enable_if_t<
+            !std::is_convertible_v<const T &, std::string_view> &&
+            std::is_convertible_v<decltype(std::declval<const T &>().data()), const char *> &&
+            std::is_integral_v<decltype(std::declval<const T &>().size())>, int> = 0>
+    LogLine &operator<<(const T &s) {
+        append(s.data(), static_cast<std::size_t>(s.size()));
+        return *this;
+    }
+
+private:
+    void append(const char *p, std::size_t n);
+
+    void appendUnsigned(unsigned long long int v);
+};
+
+// the `for` run the line at most once and end with a full statement,
+// so a `if (x) LOG_INFO << ..; else ..;` of the caller still bind its else to its own if
+#define LOG_AT(lv) \
+    if constexpr ((lv) < LogCompileLevel) {} \
+    else for (bool logAtOnce = AsyncLogger::instance().enabled(lv); logAtOnce; logAtOnce = false) LogLine{lv}
+
+#define LOG_TRACE LOG_AT(LogLevel::trace)
+#define LOG_DEBUG LOG_AT(LogLevel::debug)
+#define LOG_INFO LOG_AT(LogLevel::info)
+#define LOG_WARNING LOG_AT(LogLevel::warning)
+#define LOG_ERROR LOG_AT(LogLevel::error)
+
+
+#endif //VORZECONTROLSERVER_ASYNCLOGGER_H
@@ -0,0 +1,329 @@
+/**
+ * VorzeControlServer : A VORZE electric toys Vorze A10 Cyclone/Piston SA Remote Control Adapter Server Powered by Boost.Asio
+ * Copyright (C) 2020 Jeremie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <regex>
+#include <set>
+#include <boost/algorithm/string.hpp>
+#include <boost/asio/buffer.hpp>
+#include "VorzeFrame.h"
+#include "ActionModeManager.h"
+#include "PatternCompiler.h"
+#include "FunscriptConverter.h"
+#include "UrlQuery.h"
+#include "PtyLoopbackBenchmark.h"
+
+namespace {
+
+    // keep the compiler from drop the benchmark body
+    volatile std::size_t benchmarkSink = 0;
+
+    template<typename F>
+    void benchmarkLoop(const std::string &name, std::size_t iterations, F &&f) {
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i != iterations; ++i) {
+            f(i);
+        }
+        auto dt = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count();
+        std::cout << name << ": " << iterations << " ops, "
+                  << static_cast<double>(dt) / static_cast<double>(iterations) << " ns/op" << std::endl;
+    }
+
+    void benchmarkFrame() {
+        constexpr std::size_t iterations = 10000000;
+
+        // the old way : build array, convert to string, then copy it into a locked set until write complete
+        std::set<std::shared_ptr<std::string>> sendingData;
+        std::mutex sendingDataMtx;
+        benchmarkLoop("frame/string-copy", iterations, [&](std::size_t i) {
+            std::array<unsigned char, 3> dataBuf{1, 1, 0};
+            dataBuf[2] = static_cast<unsigned char>(i);
+            std::string data{(char *) dataBuf.data(), dataBuf.size()};
+            decltype(sendingData.emplace()) refData;
+            {
+                std::lock_guard<std::mutex> lockGuard{sendingDataMtx};
+                refData = sendingData.emplace(std::make_shared<std::string>(data));
+            }
+            auto b = boost::asio::buffer(*refData.first->get());
+            benchmarkSink = benchmarkSink + b.size() + static_cast<const unsigned char *>(b.data())[2];
+            {
+                std::lock_guard<std::mutex> lockGuard{sendingDataMtx};
+                sendingData.erase(refData.first);
+            }
+        });
+
+        // the new way : pick the pre-encoded frame from static table, hand it to asio directly
+        benchmarkLoop("frame/static-table", iterations, [&](std::size_t i) {
+            auto b = VorzeFrame::of(static_cast<uint8_t>(i)).buffer();
+            benchmarkSink = benchmarkSink + b.size() + static_cast<const unsigned char *>(b.data())[2];
+        });
+    }
+
+    void benchmarkActionCursor() {
+        constexpr std::size_t items = 100000;
+        constexpr std::size_t iterations = 20000000;
+
+        // a long pattern, the item long 1~16 tick, 1 ms per tick
+        auto action = std::make_shared<ActionInfo>();
+        action->name = "bench";
+        action->MsPerTick = 1;
+        std::vector<ActionItem> ops;
+        ops.reserve(items);
+        uint32_t timeTick = 0;
+        for (std::size_t i = 0; i != items; ++i) {
+            ActionItem a;
+            a.direct = static_cast<uint8_t>(i & 1);
+            a.speed = static_cast<uint8_t>(i % 101);
+            timeTick += static_cast<uint32_t>(1 + (i * 7) % 16);
+            a.timeTick = timeTick;
+            ops.push_back(a);
+        }
+        action->ops = ActionItemList{std::move(ops)};
+
+        boost::asio::io_context ioc;
+        auto session = std::make_shared<ActionSession>(
+                ioc.get_executor(), action, std::make_shared<TimingWheel>(boost::asio::make_strand(ioc)));
+
+        // the query time move forward 1/4 ms every lookup, so it loop over the pattern several times
+        auto position = [](std::size_t i) {
+            return ActionTimeDuration{static_cast<ActionTimeDuration::rep>(i / 4)};
+        };
+
+        // the old way : binary search every lookup
+        benchmarkLoop("action-cursor/upper_bound", iterations, [&](std::size_t i) {
+            auto tick = static_cast<uint32_t>(position(i).count() % action->ops.back().timeTick);
+            auto it = std::upper_bound(action->ops.begin(), action->ops.end(), ActionItem::createTimeTickObject(tick));
+            benchmarkSink = benchmarkSink + it->speed;
+        });
+
+        // the explicit seek : binary search the block index, then walk in the block
+        benchmarkLoop("action-cursor/block-seek", iterations, [&](std::size_t i) {
+            benchmarkSink = benchmarkSink + session->seek(position(i)).speed;
+        });
+
+        // the new way : walk the cursor forward
+        session->seek(ActionTimeDuration{0});
+        benchmarkLoop("action-cursor/cursor", iterations, [&](std::size_t i) {
+            benchmarkSink = benchmarkSink + session->getActionAt(position(i)).speed;
+        });
+
+        // check the two way give the same answer
+        session->seek(ActionTimeDuration{0});
+        std::size_t mismatch = 0;
+        for (std::size_t i = 0; i < iterations; i += 3) {
+            auto a = session->getActionAt(position(i));
+            auto tick = static_cast<uint32_t>(position(i).count() % action->ops.back().timeTick);
+            auto b = std::upper_bound(action->ops.begin(), action->ops.end(), ActionItem::createTimeTickObject(tick));
+            if (a.timeTick != b->timeTick) {
+                ++mismatch;
+            }
+        }
+        std::cout << "action-cursor/mismatch: " << mismatch << std::endl;
+    }
+
+    void benchmarkGenerator() {
+        constexpr std::size_t iterations = 20000000;
+        boost::asio::io_context ioc;
+        auto wheel = std::make_shared<TimingWheel>(boost::asio::make_strand(ioc));
+        for (const char *mode : {"sine:period=4s,min=20,max=90", "ramp:period=2s", "pulse:period=1s,duty=0.25",
+                                 "random:period=3s,seed=7,flip=10s"}) {
+            auto g = ActionGenerator::parse(mode);
+            if (g.second) {
+                std::cerr << g.second.message() << std::endl;
+                return;
+            }
+            auto session = std::make_shared<ActionSession>(ioc.get_executor(), g.first, wheel);
+            benchmarkLoop(std::string{"generator/"} + mode, iterations, [&](std::size_t i) {
+                benchmarkSink = benchmarkSink + session->getActionAt(ActionTimeDuration{
+                        static_cast<ActionTimeDuration::rep>(i / 4)}).speed;
+            });
+        }
+    }
+
+    void benchmarkPatternCompile() {
+        // a 4 hour script, a entry every 20 ms, some state repeat so they merge
+        constexpr long long int durationMs = 4LL * 60 * 60 * 1000;
+        std::string script = "# bench\nmsPerTick=10\n";
+        for (long long int t = 0, i = 0; t < durationMs; t += 20, ++i) {
+            script += std::to_string(t);
+            script += ',';
+            script += (i / 7) % 2 ? '1' : '0';
+            script += ',';
+            script += std::to_string((i / 3) % 101);
+            script += '\n';
+        }
+        script += std::to_string(durationMs) + "\n";
+
+        constexpr std::size_t chunkSize = 64 * 1024;
+        constexpr std::size_t rounds = 5;
+        std::size_t items = 0;
+        std::size_t merged = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t r = 0; r != rounds; ++r) {
+            PatternCompiler c{"bench"};
+            std::string_view v{script};
+            while (!v.empty()) {
+                auto n = std::min(chunkSize, v.size());
+                c.feed(v.substr(0, n));
+                v.remove_prefix(n);
+            }
+            auto a = c.finish();
+            if (a.second) {
+                std::cerr << "pattern-compile: " << a.second.message() << std::endl;
+                return;
+            }
+            items = a.first->ops.size();
+            merged = c.getMerged();
+            benchmarkSink = benchmarkSink + items;
+        }
+        auto dt = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count() / static_cast<long long int>(rounds);
+        std::cout << "pattern-compile: " << script.size() << " bytes, " << durationMs / 20 << " entries -> "
+                  << items << " items (" << merged << " merged), "
+                  << dt / 1000.0 << " ms, "
+                  << static_cast<double>(script.size()) / static_cast<double>(dt) << " MB/s" << std::endl;
+    }
+
+    void benchmarkFunscript() {
+        // a 1 hour script, a point every 50 ms, the stroke length and period change slowly
+        constexpr long long int durationMs = 60LL * 60 * 1000;
+        std::string script = R"({"version":"1.0","inverted":false,"range":100,"actions":[)";
+        for (long long int t = 0, i = 0; t <= durationMs; t += 50, ++i) {
+            auto period = 8 + (i / 500) % 8;
+            auto phase = i % period;
+            auto pos = phase < period / 2 ? phase * 100 / (period / 2) : (period - phase) * 100 / (period / 2);
+            if (i != 0) {
+                script += ',';
+            }
+            script += R"({"at":)" + std::to_string(t) + R"(,"pos":)" + std::to_string(pos) + "}";
+        }
+        script += "]}";
+
+        constexpr std::size_t chunkSize = 64 * 1024;
+        constexpr std::size_t rounds = 5;
+        std::size_t points = 0;
+        std::size_t items = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t r = 0; r != rounds; ++r) {
+            FunscriptConverter c{"bench"};
+            std::string_view v{script};
+            while (!v.empty()) {
+                auto n = std::min(chunkSize, v.size());
+                c.feed(v.substr(0, n));
+                v.remove_prefix(n);
+            }
+            auto a = c.finish();
+            if (a.second) {
+                std::cerr << "funscript: " << a.second.message() << std::endl;
+                return;
+            }
+            points = c.getPoints();
+            items = a.first->ops.size();
+            benchmarkSink = benchmarkSink + items;
+        }
+        auto dt = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count() / static_cast<long long int>(rounds);
+        std::cout << "funscript: " << script.size() << " bytes, " << points << " points -> "
+                  << items << " items, "
+                  << dt / 1000.0 << " ms, "
+                  << static_cast<double>(script.size()) / static_cast<double>(dt) << " MB/s" << std::endl;
+    }
+
+    void benchmarkUrlParse() {
+        constexpr std::size_t iterations = 1000000;
+        const std::string url{"/op?_targetCOM=COM3&_targetMode=none&_targetDirect=1&_targetSpeed=60"};
+
+        // the old way : regex, then split twice into a multimap
+        benchmarkLoop("url-parse/regex", iterations, [&](std::size_t) {
+            static const std::regex PARSE_URL{R"((/([^ ?]+)?)?/?\??([^/ ]+\=[^/ ]+)?)",
+                                              std::regex_constants::ECMAScript | std::regex_constants::icase};
+            std::smatch match;
+            if (!std::regex_match(url, match, PARSE_URL) || match.size() != 4) {
+                return;
+            }
+            std::string path = match[1];
+            std::string query = match[3];
+            std::vector<std::string> queryList;
+            boost::split(queryList, query, boost::is_any_of("&"));
+            std::multimap<std::string, std::string> queryPairs;
+            for (const auto &q : queryList) {
+                std::vector<std::string> p;
+                boost::split(p, q, boost::is_any_of("="));
+                queryPairs.emplace(p.at(0), p.size() > 1 ? p.at(1) : "");
+            }
+            benchmarkSink = benchmarkSink + queryPairs.find("_targetSpeed")->second.size() + path.size();
+        });
+
+        // the new way : a string_view parser, no heap allocation
+        benchmarkLoop("url-parse/string_view", iterations, [&](std::size_t) {
+            UrlQuery q;
+            if (q.parse(url)) {
+                return;
+            }
+            benchmarkSink = benchmarkSink + q.find("_targetSpeed")->value.size() + q.getPath().size();
+        });
+    }
+
+    const std::map<std::string, std::function<void()>> &benchmarks() {
+        static const std::map<std::string, std::function<void()>> m{
+                {"frame", benchmarkFrame},
+                {"action-cursor", benchmarkActionCursor},
+                {"generator", benchmarkGenerator},
+                {"pattern-compile", benchmarkPatternCompile},
+                {"funscript", benchmarkFunscript},
+                {"url-parse", benchmarkUrlParse},
+#ifndef _WIN32
+                {"pty", benchmarkPtyLoopback},
+                {"pty-group", benchmarkPtyGroup},
+#endif // _WIN32
+        };
+        return m;
+    }
+
+}
+
+int runBenchmark(const std::string &name) {
+    const auto &m = benchmarks();
+    if (name == "all") {
+        for (const auto &a : m) {
+            a.second();
+        }
+        return 0;
+    }
+    auto it = m.find(name);
+    if (it == m.end()) {
+        std::cerr << "runBenchmark() unknown benchmark: " << name << "\n";
+        std::cerr << "available benchmarks: all";
+        for (const auto &a : m) {
+            std::cerr << " " << a.first;
+        }
+        std::cerr << std::endl;
+        return -1;
+    }
+    it->second();
+    return 0;
+}
@@ -18,6 +18,8 @@
 
 #include "ConfigLoader.h"
 
+#include <stdexcept>
+
 
 void ConfigLoader::print() {
     std::cout << "config.listenHost:" << config.listenHost << "\n";
@@ -26,6 +28,25 @@ void ConfigLoader::print() {
     std::cout << "config.controlServerPort:" << config.controlServerPort << "\n";
 
     std::cout << "config.threadNum:" << config.threadNum << "\n";
+    std::cout << "config.coalesceStateCommand:" << config.coalesceStateCommand << "\n";
+    std::cout << "config.serialFlushWindowUs:" << config.serialFlushWindowUs << "\n";
+    std::cout << "config.serialWriteTimeoutMs:" << config.serialWriteTimeoutMs << "\n";
+    std::cout << "config.sysfsRoot:" << config.sysfsRoot << "\n";
+    std::cout << "config.devRoot:" << config.devRoot << "\n";
+    std::cout << "config.portPollIntervalMs:" << config.portPollIntervalMs << "\n";
+    std::cout << "config.portPollIntervalWithHotplugMs:" << config.portPollIntervalWithHotplugMs << "\n";
+    std::cout << "config.actionLibraryPath:" << config.actionLibraryPath << "\n";
+    std::cout << "config.actionScriptDir:" << config.actionScriptDir << "\n";
+    std::cout << "config.funscriptFullSpeedVelocity:" << config.funscriptFullSpeedVelocity << "\n";
+    std::cout << "config.funscriptSmoothing:" << config.funscriptSmoothing << "\n";
+    std::cout << "config.funscriptReversalsPerFlip:" << config.funscriptReversalsPerFlip << "\n";
+    std::cout << "config.syncSeekThresholdMs:" << config.syncSeekThresholdMs << "\n";
+    std::cout << "config.syncSlewMs:" << config.syncSlewMs << "\n";
+    std::cout << "config.outputLatencyEstimate:" << config.outputLatencyEstimate << "\n";
+    std::cout << "config.outputLatencyMs:" << config.outputLatencyMs << "\n";
+    std::cout << "config.controlServerIdleTimeoutMs:" << config.controlServerIdleTimeoutMs << "\n";
+    std::cout << "config.controlServerMaxRequests:" << config.controlServerMaxRequests << "\n";
+    std::cout << "config.logLevel:" << config.logLevel << "\n";
 
     if (!config.embedWebServerConfig.enable) {
         std::cout << "config.embedWebServerConfig.enable : false .\n";
@@ -67,6 +88,35 @@ void ConfigLoader::parse_json(const boost::property_tree::ptree &tree) {
     auto threadNum = tree.get("threadNum", static_cast<size_t>(0));
     c.threadNum = threadNum;
 
+    c.coalesceStateCommand = tree.get("coalesceStateCommand", c.coalesceStateCommand);
+    c.serialFlushWindowUs = tree.get("serialFlushWindowUs", c.serialFlushWindowUs);
+    c.serialWriteTimeoutMs = tree.get("serialWriteTimeoutMs", c.serialWriteTimeoutMs);
+    c.sysfsRoot = tree.get("sysfsRoot", c.sysfsRoot);
+    c.devRoot = tree.get("devRoot", c.devRoot);
+    c.portPollIntervalMs = tree.get("portPollIntervalMs", c.portPollIntervalMs);
+    c.portPollIntervalWithHotplugMs = tree.get("portPollIntervalWithHotplugMs", c.portPollIntervalWithHotplugMs);
+    if (c.portPollIntervalMs < Config::MinPortPollIntervalMs ||
+        c.portPollIntervalWithHotplugMs < Config::MinPortPollIntervalMs) {
+        throw std::invalid_argument{"config portPollIntervalMs and portPollIntervalWithHotplugMs must be >= "
+                                    + std::to_string(Config::MinPortPollIntervalMs)};
+    }
+    c.actionLibraryPath = tree.get("actionLibraryPath", c.actionLibraryPath);
+    c.actionScriptDir = tree.get("actionScriptDir", c.actionScriptDir);
+    c.funscriptFullSpeedVelocity = tree.get("funscriptFullSpeedVelocity", c.funscriptFullSpeedVelocity);
+    c.funscriptSmoothing = tree.get("funscriptSmoothing", c.funscriptSmoothing);
+    c.funscriptReversalsPerFlip = tree.get("funscriptReversalsPerFlip", c.funscriptReversalsPerFlip);
+    c.syncSeekThresholdMs = tree.get("syncSeekThresholdMs", c.syncSeekThresholdMs);
+    c.syncSlewMs = tree.get("syncSlewMs", c.syncSlewMs);
+    if (!(c.syncSlewMs > 0)) {
+        // the slew rate divide by it
+        throw std::invalid_argument{"config syncSlewMs must be > 0"};
+    }
+    c.outputLatencyEstimate = tree.get("outputLatencyEstimate", c.outputLatencyEstimate);
+    c.outputLatencyMs = tree.get("outputLatencyMs", c.outputLatencyMs);
+    c.controlServerIdleTimeoutMs = tree.get("controlServerIdleTimeoutMs", c.controlServerIdleTimeoutMs);
+    c.controlServerMaxRequests = tree.get("controlServerMaxRequests", c.controlServerMaxRequests);
+    c.logLevel = tree.get("logLevel", c.logLevel);
+
 
     c.embedWebServerConfig = {};
     c.embedWebServerConfig.enable = false;
@@ -60,6 +60,75 @@ struct Config {
     EmbedWebServerConfig embedWebServerConfig;
 
     size_t threadNum = 0;
+
+    /**
+     * collapse the pending speed/direction commands of a port into the newest one
+     */
+    bool coalesceStateCommand = true;
+
+    /**
+     * how long (microseconds) a port wait for more commands before flush them in one write,
+     * 0 means write immediately
+     */
+    size_t serialFlushWindowUs = 0;
+
+    /**
+     * the timeout (milliseconds) of a serial write, a stalled write will be canceled, 0 means never timeout
+     */
+    size_t serialWriteTimeoutMs = 1000;
+
+    /**
+     * the root of sysfs and dev that the linux SerialPortFinder scan, can point to a fake tree
+     */
+    std::string sysfsRoot = "/sys";
+    std::string devRoot = "/dev";
+
+    /**
+     * the port list rescan interval (milliseconds),
+     * the longer one used when the hotplug watcher work, then the poll is only a fallback,
+     * both must be >= MinPortPollIntervalMs, a shorter one make the rescan spin
+     */
+    static constexpr size_t MinPortPollIntervalMs = 100;
+    size_t portPollIntervalMs = 5000;
+    size_t portPollIntervalWithHotplugMs = 60000;
+
+    /**
+     * the binary pattern library file, it is memory-mapped, empty means no library
+     */
+    std::string actionLibraryPath;
+    /**
+     * the dir of pattern script (*.txt, *.csv, *.funscript), they are compiled on load, empty means none
+     */
+    std::string actionScriptDir;
+    /**
+     * the Funscript (*.funscript in actionScriptDir) convert options, see FunscriptConvertOptions
+     */
+    double funscriptFullSpeedVelocity = 400;
+    double funscriptSmoothing = 0.5;
+    unsigned funscriptReversalsPerFlip = 1;
+    /**
+     * the player sync (/sync) : a drift bigger than syncSeekThresholdMs seek directly,
+     *      a smaller one is slewed in syncSlewMs (must be > 0), at 0.5x to 2x of the player rate
+     */
+    double syncSeekThresholdMs = 200;
+    double syncSlewMs = 1000;
+    /**
+     * the mode playback send every frame early by the output latency of the port :
+     *      the measured write latency (EWMA, if outputLatencyEstimate) + outputLatencyMs (the dongle/radio calibration)
+     */
+    bool outputLatencyEstimate = true;
+    double outputLatencyMs = 0;
+    /**
+     * the control server keep a connection alive (HTTP/1.1 keep-alive, pipelined request answered in order),
+     *      close it after idle controlServerIdleTimeoutMs, or after answered controlServerMaxRequests request
+     */
+    size_t controlServerIdleTimeoutMs = 30000;
+    size_t controlServerMaxRequests = 1000;
+    /**
+     * the runtime log level : trace, debug, info, warning, error, off.
+     *      the level below LOG_COMPILE_LEVEL (a build option) is compiled out anyway
+     */
+    std::string logLevel = "info";
 };
 
 class ConfigLoader : public std::enable_shared_from_this<ConfigLoader> {
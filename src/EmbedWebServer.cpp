@@ -20,6 +20,7 @@
 
 #include <filesystem>
 #include <boost/algorithm/string.hpp>
+#include "AsyncLogger.h"
 
 // Return a reasonable mime type based on the extension of a file.
 boost::beast::string_view
@@ -324,7 +325,7 @@ void EmbedWebServerSession::on_read(boost::beast::error_code ec, std::size_t byt
         return fail(ec, "read");
 
 
-    std::cout << "req_.target():" << req_.target() << std::endl;
+    LOG_INFO << "req_.target():" << req_.target();
     if (req_.method() == boost::beast::http::verb::get) {
         // answer backend json
         if (boost::beast::string_view{req_.target()}.to_string() == std::string{"/backend"}) {
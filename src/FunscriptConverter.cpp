@@ -0,0 +1,285 @@
+/**
+ * VorzeControlServer : A VORZE electric toys Vorze A10 Cyclone/Piston SA Remote Control Adapter Server Powered by Boost.Asio
+ * Copyright (C) 2020 Jeremie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "FunscriptConverter.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <boost/filesystem.hpp>
+
+namespace {
+    // the token we care are short, a longer one is cut, it never match
+    constexpr std::size_t MaxTokenSize = 32;
+}
+
+FunscriptConverter::FunscriptConverter(std::string name, FunscriptConvertOptions options)
+        : name(std::move(name)),
+          options(options) {
+    if (this->options.msPerTick <= 0) {
+        this->options.msPerTick = FunscriptConvertOptions{}.msPerTick;
+    }
+    if (!(this->options.fullSpeedVelocity > 0)) {
+        this->options.fullSpeedVelocity = FunscriptConvertOptions{}.fullSpeedVelocity;
+    }
+    this->options.smoothing = std::clamp(this->options.smoothing, 0.0, 0.99);
+    if (this->options.reversalsPerFlip == 0) {
+        this->options.reversalsPerFlip = 1;
+    }
+    token.reserve(MaxTokenSize);
+    number.reserve(MaxTokenSize);
+}
+
+const error_info &FunscriptConverter::feed(std::string_view chunk) {
+    for (auto c : chunk) {
+        if (error) {
+            break;
+        }
+        scan(c);
+    }
+    return error;
+}
+
+void FunscriptConverter::scan(char c) {
+    if (inString) {
+        if (escape) {
+            escape = false;
+        } else if (c == '\\') {
+            escape = true;
+            return;
+        } else if (c == '"') {
+            inString = false;
+            if (expectingValue) {
+                // a string value, we dont care it
+                expectingValue = false;
+            } else {
+                lastKey = token;
+            }
+            return;
+        }
+        if (token.size() < MaxTokenSize) {
+            token.push_back(c);
+        }
+        return;
+    }
+
+    switch (c) {
+        case '"':
+            inString = true;
+            token.clear();
+            return;
+        case ':':
+            expectingValue = true;
+            return;
+        case '{':
+        case '[':
+            flushNumber();
+            ++depth;
+            if (c == '[' && expectingValue && depth == 2 && lastKey == "actions") {
+                actionsDepth = depth;
+            }
+            if (c == '{' && actionsDepth != -1 && depth == actionsDepth + 1) {
+                objectHasAt = false;
+                objectHasPos = false;
+            }
+            expectingValue = false;
+            return;
+        case '}':
+        case ']':
+            flushNumber();
+            if (c == '}' && actionsDepth != -1 && depth == actionsDepth + 1 && objectHasAt && objectHasPos) {
+                pushPoint(objectAt, objectPos);
+            }
+            if (c == ']' && depth == actionsDepth) {
+                actionsDepth = -1;
+            }
+            --depth;
+            expectingValue = false;
+            return;
+        case ',':
+            flushNumber();
+            expectingValue = false;
+            return;
+        case ' ':
+        case '\t':
+        case '\r':
+        case '\n':
+            return;
+        default:
+            if (expectingValue && number.size() < MaxTokenSize) {
+                number.push_back(c);
+            }
+            return;
+    }
+}
+
+void FunscriptConverter::flushNumber() {
+    if (number.empty()) {
+        return;
+    }
+    if (actionsDepth != -1 && depth == actionsDepth + 1) {
+        // std::from_chars of double not ready on every compiler we use
+        char *end = nullptr;
+        auto v = std::strtod(number.c_str(), &end);
+        if (end != number.c_str() + number.size()) {
+            // true/false/null or a broken number, not a point field
+        } else if (lastKey == "at") {
+            objectAt = v;
+            objectHasAt = true;
+        } else if (lastKey == "pos") {
+            objectPos = v;
+            objectHasPos = true;
+        }
+    }
+    number.clear();
+}
+
+void FunscriptConverter::pushPoint(double a, double p) {
+    // strtod take nan, inf and 1e999, they break the sort check and the std::llround below
+    if (!std::isfinite(a) || !std::isfinite(p)) {
+        error = error_info{"FunscriptConverter " + name + " : at or pos not a finite number"};
+        return;
+    }
+    if (a / static_cast<double>(options.msPerTick) > static_cast<double>(UINT32_MAX)) {
+        error = error_info{"FunscriptConverter " + name + " : at out of range"};
+        return;
+    }
+    if (a < 0) {
+        error = error_info{"FunscriptConverter " + name + " : negative at"};
+        return;
+    }
+    p = std::clamp(p, 0.0, 100.0);
+    if (!hasPrevious) {
+        // the first point, stop until it
+        at[0] = a;
+        pos[0] = p;
+        hasPrevious = true;
+        ++points;
+        if (!items.append(0, 0, std::llround(a / static_cast<double>(options.msPerTick)))) {
+            error = error_info{"FunscriptConverter " + name + " : at out of range"};
+        }
+        return;
+    }
+    if (a < at[chunkPoints]) {
+        error = error_info{"FunscriptConverter " + name + " : actions not sort by at"};
+        return;
+    }
+    if (a == at[chunkPoints]) {
+        // the same time, the later one win
+        pos[chunkPoints] = p;
+        return;
+    }
+    ++points;
+    ++chunkPoints;
+    at[chunkPoints] = a;
+    pos[chunkPoints] = p;
+    if (chunkPoints == ChunkSize) {
+        processChunk();
+    }
+}
+
+void FunscriptConverter::processChunk() {
+    const auto n = chunkPoints;
+    if (n == 0) {
+        return;
+    }
+
+    // pass 1 : the speed of every segment, no branch and no dependency between the iterations, so it vectorize
+    const double scale = 1000.0 * 100.0 / options.fullSpeedVelocity;
+    for (std::size_t i = 1; i <= n; ++i) {
+        velocity[i] = (pos[i] - pos[i - 1]) / (at[i] - at[i - 1]);
+    }
+
+    // pass 2 : the smoothing and the direction depend on the previous segment, so it is scalar
+    const double alpha = options.smoothing;
+    const auto msPerTick = static_cast<double>(options.msPerTick);
+    for (std::size_t i = 1; i <= n; ++i) {
+        auto v = velocity[i];
+        auto raw = std::min(std::fabs(v) * scale, 100.0);
+        smoothedSpeed = alpha * smoothedSpeed + (1.0 - alpha) * raw;
+
+        int sign = (v > 0) - (v < 0);
+        if (sign != 0) {
+            if (lastSign != 0 && sign != lastSign && ++reversals % options.reversalsPerFlip == 0) {
+                direct = static_cast<uint8_t>(direct ^ 1);
+            }
+            lastSign = sign;
+        }
+
+        auto speed = static_cast<uint8_t>(std::lround(smoothedSpeed));
+        if (!items.append(direct, speed, std::llround(at[i] / msPerTick))) {
+            error = error_info{"FunscriptConverter " + name + " : at out of range"};
+            return;
+        }
+    }
+
+    // carry the last point as the begin of next chunk
+    at[0] = at[n];
+    pos[0] = pos[n];
+    chunkPoints = 0;
+}
+
+std::pair<std::shared_ptr<ActionInfo>, error_info> FunscriptConverter::finish() {
+    if (!error) {
+        processChunk();
+    }
+    if (error) {
+        return {{}, error};
+    }
+    if (points < 2) {
+        return {{}, error_info{"FunscriptConverter " + name + " : need 2 actions at least"}};
+    }
+    // stop at the end
+    items.append(0, 0, items.lastTick() + 1);
+    auto a = std::make_shared<ActionInfo>();
+    a->name = name;
+    a->MsPerTick = options.msPerTick;
+    a->ops = ActionItemList{items.release()};
+    return {a, {}};
+}
+
+std::pair<std::shared_ptr<ActionInfo>, error_info> FunscriptConverter::convert(
+        std::istream &in, const std::string &name, const FunscriptConvertOptions &options) {
+    FunscriptConverter c{name, options};
+    std::array<char, 64 * 1024> buffer{};
+    while (in) {
+        in.read(buffer.data(), buffer.size());
+        auto n = static_cast<std::size_t>(in.gcount());
+        if (n == 0) {
+            break;
+        }
+        if (c.feed(std::string_view{buffer.data(), n})) {
+            break;
+        }
+    }
+    if (in.bad()) {
+        return {{}, error_info{"FunscriptConverter " + name + " : read error"}};
+    }
+    return c.finish();
+}
+
+std::pair<std::shared_ptr<ActionInfo>, error_info> FunscriptConverter::convertFile(
+        const std::string &path, const FunscriptConvertOptions &options) {
+    std::ifstream f{path, std::ios::binary};
+    if (!f) {
+        return {{}, error_info{"FunscriptConverter cannot open " + path}};
+    }
+    return convert(f, boost::filesystem::path{path}.stem().string(), options);
+}
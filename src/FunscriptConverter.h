@@ -0,0 +1,138 @@
+/**
+ * VorzeControlServer : A VORZE electric toys Vorze A10 Cyclone/Piston SA Remote Control Adapter Server Powered by Boost.Asio
+ * Copyright (C) 2020 Jeremie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VORZECONTROLSERVER_FUNSCRIPTCONVERTER_H
+#define VORZECONTROLSERVER_FUNSCRIPTCONVERTER_H
+
+#ifdef MSVC
+#pragma once
+#endif
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include "ActionInfo.h"
+#include "error_info.h"
+
+struct FunscriptConvertOptions {
+    long long int msPerTick = 10;
+    /**
+     * the stroke velocity (position unit per second) that map to the max rotation speed 100
+     */
+    double fullSpeedVelocity = 400;
+    /**
+     * the EMA factor of the speed, in [0, 1), 0 means no smoothing
+     */
+    double smoothing = 0.5;
+    /**
+     * flip the rotation direction every N stroke reversal
+     */
+    unsigned reversalsPerFlip = 1;
+};
+
+/**
+ * convert a Funscript (the position over time script for the linear device) to the rotation pattern of Cyclone.
+ *      the speed come from the position derivative, the direction flip on the stroke reversal.
+ *
+ * it is streaming : feed() scan the json by char and only keep the `at`/`pos` of the `actions` array,
+ *      the points are buffered as SoA in a fixed chunk, a full chunk run a branch-free velocity pass
+ *      (the compiler can vectorize it) then a scalar smoothing pass that emit the items directly,
+ *      so the memory not grow with the script length except the output.
+ */
+class FunscriptConverter {
+public:
+    static constexpr std::size_t ChunkSize = 1024;
+
+private:
+    std::string name;
+    FunscriptConvertOptions options;
+    error_info error;
+
+    // ---- the json scanner state
+    bool inString = false;
+    bool escape = false;
+    bool expectingValue = false;
+    int depth = 0;
+    // the depth of the `actions` array, -1 if not in it
+    int actionsDepth = -1;
+    std::string token;
+    std::string lastKey;
+    std::string number;
+    double objectAt = 0;
+    double objectPos = 0;
+    bool objectHasAt = false;
+    bool objectHasPos = false;
+
+    // ---- the point chunk, index 0 is the last point of previous chunk
+    std::array<double, ChunkSize + 1> at{};
+    std::array<double, ChunkSize + 1> pos{};
+    std::array<double, ChunkSize + 1> velocity{};
+    std::size_t chunkPoints = 0;
+    bool hasPrevious = false;
+    std::size_t points = 0;
+
+    // ---- the output state
+    double smoothedSpeed = 0;
+    int lastSign = 0;
+    unsigned reversals = 0;
+    uint8_t direct = 0;
+    ActionItemBuilder items;
+
+public:
+    explicit FunscriptConverter(std::string name, FunscriptConvertOptions options = {});
+
+    const error_info &feed(std::string_view chunk);
+
+    std::pair<std::shared_ptr<ActionInfo>, error_info> finish();
+
+    [[nodiscard]]
+    std::size_t getPoints() const {
+        return points;
+    }
+
+    [[nodiscard]]
+    std::size_t getMerged() const {
+        return items.getMerged();
+    }
+
+    static std::pair<std::shared_ptr<ActionInfo>, error_info> convert(
+            std::istream &in, const std::string &name, const FunscriptConvertOptions &options = {});
+
+    /**
+     * the pattern name is the file name without extension
+     */
+    static std::pair<std::shared_ptr<ActionInfo>, error_info> convertFile(
+            const std::string &path, const FunscriptConvertOptions &options = {});
+
+private:
+    void scan(char c);
+
+    void flushNumber();
+
+    void pushPoint(double a, double p);
+
+    void processChunk();
+};
+
+
+#endif //VORZECONTROLSERVER_FUNSCRIPTCONVERTER_H
@@ -0,0 +1,120 @@
+/**
+ * VorzeControlServer : A VORZE electric toys Vorze A10 Cyclone/Piston SA Remote Control Adapter Server Powered by Boost.Asio
+ * Copyright (C) 2020 Jeremie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VORZECONTROLSERVER_LATENCYHISTOGRAM_H
+#define VORZECONTROLSERVER_LATENCYHISTOGRAM_H
+
+#ifdef MSVC
+#pragma once
+#endif
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * a lock-free latency histogram with log2 buckets in microseconds.
+ *      bucket 0 hold [0, 1us], bucket i hold (2^(i-1), 2^i] us, the last bucket hold everything bigger.
+ *      record() can be called from any thread, the percentile is the upper bound of the bucket.
+ */
+class LatencyHistogram {
+public:
+    static constexpr std::size_t BucketCount = 32;
+
+private:
+    std::array<std::atomic<uint64_t>, BucketCount> buckets{};
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sumUs{0};
+    std::atomic<uint64_t> maxUs{0};
+
+    static std::size_t bucketOf(uint64_t us) {
+        std::size_t i = 0;
+        uint64_t bound = 1;
+        while (us > bound && i + 1 < BucketCount) {
+            bound <<= 1;
+            ++i;
+        }
+        return i;
+    }
+
+public:
+
+    static constexpr uint64_t bucketUpperBoundUs(std::size_t i) {
+        return uint64_t{1} << i;
+    }
+
+    template<class Rep, class Period>
+    void record(std::chrono::duration<Rep, Period> d) {
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+        recordUs(us < 0 ? 0 : static_cast<uint64_t>(us));
+    }
+
+    void recordUs(uint64_t us) {
+        buckets[bucketOf(us)].fetch_add(1, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+        sumUs.fetch_add(us, std::memory_order_relaxed);
+        auto m = maxUs.load(std::memory_order_relaxed);
+        while (us > m && !maxUs.compare_exchange_weak(m, us, std::memory_order_relaxed)) {
+        }
+    }
+
+    [[nodiscard]]
+    uint64_t getCount() const {
+        return count.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]]
+    uint64_t getMaxUs() const {
+        return maxUs.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]]
+    double getMeanUs() const {
+        auto c = getCount();
+        return c == 0 ? 0 : static_cast<double>(sumUs.load(std::memory_order_relaxed)) / static_cast<double>(c);
+    }
+
+    /**
+     * @param p in [0, 1], e.g. 0.99
+     * @return the upper bound (us) of the bucket that hold the p-th sample, 0 if empty
+     */
+    [[nodiscard]]
+    uint64_t percentileUs(double p) const {
+        auto c = getCount();
+        if (c == 0) {
+            return 0;
+        }
+        auto target = static_cast<uint64_t>(p * static_cast<double>(c));
+        if (target >= c) {
+            target = c - 1;
+        }
+        uint64_t seen = 0;
+        for (std::size_t i = 0; i != BucketCount; ++i) {
+            seen += buckets[i].load(std::memory_order_relaxed);
+            if (seen > target) {
+                return bucketUpperBoundUs(i);
+            }
+        }
+        return getMaxUs();
+    }
+};
+
+
+#endif //VORZECONTROLSERVER_LATENCYHISTOGRAM_H
@@ -0,0 +1,180 @@
+/**
+ * VorzeControlServer : A VORZE electric toys Vorze A10 Cyclone/Piston SA Remote Control Adapter Server Powered by Boost.Asio
+ * Copyright (C) 2020 Jeremie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VORZECONTROLSERVER_MPSCRING_H
+#define VORZECONTROLSERVER_MPSCRING_H
+
+#ifdef MSVC
+#pragma once
+#endif
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+struct MpscRingState {
+    std::size_t capacity = 0;
+    std::size_t size = 0;
+    std::size_t highWater = 0;
+    std::size_t overflow = 0;
+};
+
+/**
+ * a fixed-capacity multi-producer/single-consumer ring.
+ *      every slot carry a sequence number (Dmitry Vyukov's bounded queue),
+ *      so producers only race on one CAS, and never lock or allocate.
+ *
+ * tryPop() must only be called from one consumer at a time (e.g. from a strand).
+ */
+template<typename T, std::size_t Capacity>
+class MpscRing {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "MpscRing Capacity must be power of two");
+
+    static constexpr std::size_t mask = Capacity - 1;
+    static constexpr std::size_t cacheLineSize = 64;
+
+    struct Cell {
+        std::atomic<std::size_t> sequence;
+        T data;
+    };
+
+    std::array<Cell, Capacity> cells;
+
+    alignas(cacheLineSize) std::atomic<std::size_t> enqueuePos{0};
+    alignas(cacheLineSize) std::atomic<std::size_t> dequeuePos{0};
+    alignas(cacheLineSize) std::atomic<std::size_t> overflowCount{0};
+    std::atomic<std::size_t> highWater{0};
+
+public:
+    MpscRing() {
+        for (std::size_t i = 0; i != Capacity; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscRing(const MpscRing &) = delete;
+
+    MpscRing &operator=(const MpscRing &) = delete;
+
+    /**
+     * @return false if the ring is full, the overflow counter will increase.
+     */
+    bool tryPush(T &&v) {
+        auto pos = enqueuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell &c = cells[pos & mask];
+            auto seq = c.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                // the slot still hold a item not consumed, so the ring is full
+                overflowCount.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        Cell &c = cells[pos & mask];
+        c.data = std::move(v);
+        c.sequence.store(pos + 1, std::memory_order_release);
+
+        // the consumer may pop this item (and more) before the load, and a stale dequeuePos may look older,
+        // so clamp it like size(), a wrapped value will stick in highWater forever
+        auto d = dequeuePos.load(std::memory_order_relaxed);
+        auto used = pos + 1 > d ? pos + 1 - d : 0;
+        if (used > Capacity) {
+            used = Capacity;
+        }
+        auto hw = highWater.load(std::memory_order_relaxed);
+        while (used > hw && !highWater.compare_exchange_weak(hw, used, std::memory_order_relaxed)) {
+        }
+        return true;
+    }
+
+    /**
+     * single consumer only
+     * @return false if the ring is empty
+     */
+    bool tryPop(T &out) {
+        auto pos = dequeuePos.load(std::memory_order_relaxed);
+        Cell &c = cells[pos & mask];
+        auto seq = c.sequence.load(std::memory_order_acquire);
+        if (static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1) < 0) {
+            return false;
+        }
+        out = std::move(c.data);
+        // drop anything the moved-from item still hold, e.g. the callback captures
+        c.data = T{};
+        dequeuePos.store(pos + 1, std::memory_order_relaxed);
+        c.sequence.store(pos + Capacity, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * single consumer only
+     * @return the next item that tryPop() will return, or nullptr if the ring is empty
+     */
+    T *peek() {
+        auto pos = dequeuePos.load(std::memory_order_relaxed);
+        Cell &c = cells[pos & mask];
+        auto seq = c.sequence.load(std::memory_order_acquire);
+        if (static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1) < 0) {
+            return nullptr;
+        }
+        return &c.data;
+    }
+
+    [[nodiscard]]
+    bool empty() const {
+        auto pos = dequeuePos.load(std::memory_order_relaxed);
+        auto seq = cells[pos & mask].sequence.load(std::memory_order_acquire);
+        return static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1) < 0;
+    }
+
+    /**
+     * approximate, only for report
+     */
+    [[nodiscard]]
+    std::size_t size() const {
+        auto d = dequeuePos.load(std::memory_order_relaxed);
+        auto e = enqueuePos.load(std::memory_order_relaxed);
+        return e > d ? e - d : 0;
+    }
+
+    static constexpr std::size_t capacity() {
+        return Capacity;
+    }
+
+    [[nodiscard]]
+    MpscRingState state() const {
+        MpscRingState s;
+        s.capacity = Capacity;
+        s.size = size();
+        s.highWater = highWater.load(std::memory_order_relaxed);
+        s.overflow = overflowCount.load(std::memory_order_relaxed);
+        return s;
+    }
+};
+
+
+#endif //VORZECONTROLSERVER_MPSCRING_H
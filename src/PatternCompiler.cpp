@@ -0,0 +1,251 @@
+/**
+ * VorzeControlServer : A VORZE electric toys Vorze A10 Cyclone/Piston SA Remote Control Adapter Server Powered by Boost.Asio
+ * Copyright (C) 2020 Jeremie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "PatternCompiler.h"
+
+#include <array>
+#include <charconv>
+#include <fstream>
+#include <boost/filesystem.hpp>
+
+namespace {
+    bool isSeparator(char c) {
+        return c == ',' || c == ';' || c == ' ' || c == '\t';
+    }
+
+    std::string_view trim(std::string_view s) {
+        while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) {
+            s.remove_prefix(1);
+        }
+        while (!s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '\r')) {
+            s.remove_suffix(1);
+        }
+        return s;
+    }
+
+    /**
+     * parse the integer fields of a line
+     * @return the field count, or -1 on a bad field or too many field
+     */
+    template<std::size_t N>
+    int parseFields(std::string_view s, std::array<long long int, N> &out) {
+        std::size_t n = 0;
+        const char *p = s.data();
+        const char *end = s.data() + s.size();
+        while (p != end) {
+            while (p != end && isSeparator(*p)) {
+                ++p;
+            }
+            if (p == end) {
+                break;
+            }
+            if (n == N) {
+                return -1;
+            }
+            auto r = std::from_chars(p, end, out[n]);
+            if (r.ec != std::errc{} || (r.ptr != end && !isSeparator(*r.ptr))) {
+                return -1;
+            }
+            p = r.ptr;
+            ++n;
+        }
+        return static_cast<int>(n);
+    }
+}
+
+const error_info &PatternCompiler::feed(std::string_view chunk) {
+    if (error) {
+        return error;
+    }
+    if (!pending.empty()) {
+        // complete the line that split by the last chunk
+        auto nl = chunk.find('\n');
+        if (nl == std::string_view::npos) {
+            pending.append(chunk);
+            return error;
+        }
+        pending.append(chunk.substr(0, nl));
+        parseLine(pending);
+        pending.clear();
+        chunk.remove_prefix(nl + 1);
+    }
+    while (!error) {
+        auto nl = chunk.find('\n');
+        if (nl == std::string_view::npos) {
+            pending.assign(chunk);
+            break;
+        }
+        parseLine(chunk.substr(0, nl));
+        chunk.remove_prefix(nl + 1);
+    }
+    return error;
+}
+
+std::pair<std::shared_ptr<ActionInfo>, error_info> PatternCompiler::finish() {
+    if (!error && !pending.empty()) {
+        parseLine(pending);
+        pending.clear();
+    }
+    if (error) {
+        return {{}, error};
+    }
+    if (hasState && !ended) {
+        // no end line, the last state long 1 tick
+        closeState(tickOf(stateTime) + 1);
+        hasState = false;
+    }
+    if (error) {
+        return {{}, error};
+    }
+    if (items.empty()) {
+        return {{}, error_info{"PatternCompiler " + name + " : empty pattern"}};
+    }
+    auto a = std::make_shared<ActionInfo>();
+    a->name = name;
+    a->MsPerTick = msPerTick;
+    a->ops = ActionItemList{items.release()};
+    return {a, {}};
+}
+
+void PatternCompiler::fail(const std::string &what) {
+    if (!error) {
+        error = error_info{"PatternCompiler " + name + " line " + std::to_string(lineNumber) + " : " + what};
+    }
+}
+
+void PatternCompiler::parseLine(std::string_view line) {
+    ++lineNumber;
+    line = trim(line);
+    if (line.empty() || line.front() == '#') {
+        return;
+    }
+
+    constexpr std::string_view msPerTickKey = "msPerTick=";
+    if (line.substr(0, msPerTickKey.size()) == msPerTickKey) {
+        if (hasState || ended) {
+            fail("msPerTick must before the first entry");
+            return;
+        }
+        std::array<long long int, 1> v{};
+        if (parseFields(line.substr(msPerTickKey.size()), v) != 1 || v[0] <= 0) {
+            fail("bad msPerTick");
+            return;
+        }
+        msPerTick = v[0];
+        return;
+    }
+
+    std::array<long long int, 3> f{};
+    auto n = parseFields(line, f);
+    if (n != 1 && n != 3) {
+        fail("need `time,direct,speed` or `time`");
+        return;
+    }
+    if (ended) {
+        fail("entry after the end line");
+        return;
+    }
+    auto time = f[0];
+    if (time < 0) {
+        fail("negative time");
+        return;
+    }
+    if (time / msPerTick > static_cast<long long int>(UINT32_MAX)) {
+        // check it before any arithmetic on time, a time near LLONG_MAX overflow the rounding
+        fail("time out of range");
+        return;
+    }
+    if (hasState && time <= stateTime) {
+        fail("time not increasing");
+        return;
+    }
+    if (n == 1) {
+        if (!hasState) {
+            fail("end line without entry");
+            return;
+        }
+        closeState(tickOf(time));
+        ended = true;
+        return;
+    }
+    if (f[1] != 0 && f[1] != 1) {
+        fail("direct must be 0 or 1");
+        return;
+    }
+    if (f[2] < 0 || f[2] > 100) {
+        fail("speed must in [0, 100]");
+        return;
+    }
+    ++entries;
+    if (!hasState && time > 0) {
+        // stop until the first entry
+        hasState = true;
+        stateTime = 0;
+        stateDirect = 0;
+        stateSpeed = 0;
+    }
+    if (hasState && !closeState(tickOf(time))) {
+        return;
+    }
+    hasState = true;
+    stateTime = time;
+    stateDirect = static_cast<uint8_t>(f[1]);
+    stateSpeed = static_cast<uint8_t>(f[2]);
+}
+
+long long int PatternCompiler::tickOf(long long int time) const {
+    // same as (time + msPerTick / 2) / msPerTick, but not add before divide
+    return time / msPerTick + (time % msPerTick >= msPerTick - msPerTick / 2 ? 1 : 0);
+}
+
+bool PatternCompiler::closeState(long long int endTick) {
+    if (!items.append(stateDirect, stateSpeed, endTick)) {
+        fail("time out of range");
+        return false;
+    }
+    return true;
+}
+
+std::pair<std::shared_ptr<ActionInfo>, error_info> PatternCompiler::compile(
+        std::istream &in, const std::string &name, long long int msPerTick) {
+    PatternCompiler c{name, msPerTick};
+    std::array<char, 64 * 1024> buffer{};
+    while (in) {
+        in.read(buffer.data(), buffer.size());
+        auto n = static_cast<std::size_t>(in.gcount());
+        if (n == 0) {
+            break;
+        }
+        if (c.feed(std::string_view{buffer.data(), n})) {
+            break;
+        }
+    }
+    if (in.bad()) {
+        return {{}, error_info{"PatternCompiler " + name + " : read error"}};
+    }
+    return c.finish();
+}
+
+std::pair<std::shared_ptr<ActionInfo>, error_info> PatternCompiler::compileFile(
+        const std::string &path, long long int msPerTick) {
+    std::ifstream f{path, std::ios::binary};
+    if (!f) {
+        return {{}, error_info{"PatternCompiler cannot open " + path}};
+    }
+    return compile(f, boost::filesystem::path{path}.stem().string(), msPerTick);
+}
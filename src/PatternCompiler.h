@@ -0,0 +1,131 @@
+/**
+ * VorzeControlServer : A VORZE electric toys Vorze A10 Cyclone/Piston SA Remote Control Adapter Server Powered by Boost.Asio
+ * Copyright (C) 2020 Jeremie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VORZECONTROLSERVER_PATTERNCOMPILER_H
+#define VORZECONTROLSERVER_PATTERNCOMPILER_H
+
+#ifdef MSVC
+#pragma once
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "ActionInfo.h"
+#include "error_info.h"
+
+/**
+ * compile a text pattern script into ActionInfo, the script is line-oriented (or CSV) :
+ *
+ *      # comment
+ *      msPerTick=10        (optional, before the first entry)
+ *      0,1,50              time(ms), direct(0/1), speed(0~100) : the state start at this time
+ *      1200,0,30
+ *      60000               a line of time only : the end of the pattern (optional, default the last state long 1 tick)
+ *
+ *      the field separator can be `,` `;` space or tab.
+ *
+ * it is a streaming parser, feed() take any size chunk, only the tail incomplete line is keep,
+ *      the items are emitted (and merged with the previous same state) as soon as their end is known.
+ */
+class PatternCompiler {
+public:
+    static constexpr long long int DefaultMsPerTick = 10;
+
+private:
+    std::string name;
+    long long int msPerTick;
+
+    // the incomplete line of last chunk
+    std::string pending;
+    std::size_t lineNumber = 0;
+    error_info error;
+
+    ActionItemBuilder items;
+    std::size_t entries = 0;
+
+    // the state that wait for its end
+    bool hasState = false;
+    long long int stateTime = 0;
+    uint8_t stateDirect = 0;
+    uint8_t stateSpeed = 0;
+    bool ended = false;
+
+public:
+    explicit PatternCompiler(std::string name, long long int msPerTick = DefaultMsPerTick)
+            : name(std::move(name)),
+              msPerTick(msPerTick > 0 ? msPerTick : DefaultMsPerTick) {}
+
+    /**
+     * @return the first error, the later chunk is ignored after a error
+     */
+    const error_info &feed(std::string_view chunk);
+
+    std::pair<std::shared_ptr<ActionInfo>, error_info> finish();
+
+    [[nodiscard]]
+    std::size_t getLines() const {
+        return lineNumber;
+    }
+
+    [[nodiscard]]
+    std::size_t getEntries() const {
+        return entries;
+    }
+
+    /**
+     * @return how many item was merged into the previous same state item
+     */
+    [[nodiscard]]
+    std::size_t getMerged() const {
+        return items.getMerged();
+    }
+
+    static std::pair<std::shared_ptr<ActionInfo>, error_info> compile(
+            std::istream &in, const std::string &name, long long int msPerTick = DefaultMsPerTick);
+
+    /**
+     * the pattern name is the file name without extension
+     */
+    static std::pair<std::shared_ptr<ActionInfo>, error_info> compileFile(
+            const std::string &path, long long int msPerTick = DefaultMsPerTick);
+
+private:
+    void parseLine(std::string_view line);
+
+    void fail(const std::string &what);
+
+    /**
+     * round `time` to the nearest tick, never overflow
+     */
+    [[nodiscard]]
+    long long int tickOf(long long int time) const;
+
+    /**
+     * end the waiting state at `endTick`
+     */
+    bool closeState(long long int endTick);
+};
+
+
+#endif //VORZECONTROLSERVER_PATTERNCOMPILER_H
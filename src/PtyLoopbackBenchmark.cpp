@@ -0,0 +1,352 @@
+/**
+ * VorzeControlServer : A VORZE electric toys Vorze A10 Cyclone/Piston SA Remote Control Adapter Server Powered by Boost.Asio
+ * Copyright (C) 2020 Jeremie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "PtyLoopbackBenchmark.h"
+
+#ifndef _WIN32
+
+#include <pty.h>
+#include <poll.h>
+#include <unistd.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/asio.hpp>
+#include "SerialPortControlServer.h"
+#include "LatencyHistogram.h"
+
+namespace {
+
+    using BenchClock = std::chrono::steady_clock;
+
+    int64_t nowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                BenchClock::now().time_since_epoch()).count();
+    }
+
+    struct PtyPair {
+        int master = -1;
+        int slave = -1;
+        std::string slaveName;
+
+        bool open() {
+            std::array<char, 256> name{};
+            if (::openpty(&master, &slave, name.data(), nullptr, nullptr) != 0) {
+                return false;
+            }
+            slaveName = name.data();
+            return true;
+        }
+
+        ~PtyPair() {
+            if (slave >= 0) {
+                ::close(slave);
+            }
+            if (master >= 0) {
+                ::close(master);
+            }
+        }
+    };
+
+    enum class PtyBenchMode {
+        // plain ordered frames through sendAsync, every frame reach the wire
+        sendAsync,
+        // every producer wait its frame written before send next, the replacement of the old blocking sendSync
+        orderedWait,
+        // setState speed frames, coalesced when the port busy
+        setState,
+    };
+
+    const char *modeName(PtyBenchMode mode) {
+        switch (mode) {
+            case PtyBenchMode::sendAsync:
+                return "sendAsync";
+            case PtyBenchMode::orderedWait:
+                return "orderedWait";
+            case PtyBenchMode::setState:
+                return "setState";
+        }
+        return "";
+    }
+
+    void runPtyBench(PtyBenchMode mode, std::size_t concurrency, std::size_t totalCommands) {
+        PtyPair pty;
+        if (!pty.open()) {
+            std::cerr << "benchmarkPtyLoopback() openpty failed." << std::endl;
+            return;
+        }
+
+        boost::asio::io_context ioc;
+        auto work = boost::asio::make_work_guard(ioc);
+        std::thread ioThread([&ioc]() {
+            ioc.run();
+        });
+
+        auto configLoader = std::make_shared<ConfigLoader>();
+        auto actionModeManager = std::make_shared<ActionModeManager>(
+                configLoader, std::make_shared<TimingWheel>(boost::asio::make_strand(ioc)));
+        auto session = std::make_shared<SerialPortSession>(
+                boost::asio::make_strand(ioc), configLoader, actionModeManager);
+
+        std::promise<error_info> opened;
+        session->init(pty.slaveName, [&opened](const error_info &e) {
+            opened.set_value(e);
+        });
+        auto openError = opened.get_future().get();
+        if (openError) {
+            std::cerr << "benchmarkPtyLoopback() open " << pty.slaveName << " failed: " << openError.message()
+                      << std::endl;
+            work.reset();
+            ioc.stop();
+            ioThread.join();
+            return;
+        }
+
+        // the enqueue time of the last command that use this command byte
+        std::array<std::atomic<int64_t>, 256> enqueueNs{};
+        LatencyHistogram wireLatency;
+        std::atomic_bool readerStop{false};
+        std::atomic<std::size_t> wireBytes{0};
+        std::atomic<int64_t> lastWireNs{0};
+
+        std::thread reader([&]() {
+            std::array<uint8_t, 4096> buf{};
+            std::size_t framePos = 0;
+            while (!readerStop.load()) {
+                pollfd p{pty.master, POLLIN, 0};
+                if (::poll(&p, 1, 50) <= 0) {
+                    continue;
+                }
+                auto n = ::read(pty.master, buf.data(), buf.size());
+                if (n <= 0) {
+                    continue;
+                }
+                auto t = nowNs();
+                for (ssize_t i = 0; i != n; ++i) {
+                    if (framePos == VorzeFrame::Size - 1) {
+                        auto sent = enqueueNs[buf[i]].load(std::memory_order_relaxed);
+                        if (sent != 0) {
+                            wireLatency.recordUs(static_cast<uint64_t>((t - sent) / 1000));
+                        }
+                    }
+                    framePos = (framePos + 1) % VorzeFrame::Size;
+                }
+                wireBytes.fetch_add(static_cast<std::size_t>(n));
+                lastWireNs.store(t);
+            }
+        });
+
+        std::atomic<std::size_t> sequence{0};
+        std::atomic<std::size_t> inflight{0};
+        std::atomic<std::size_t> completed{0};
+        std::atomic<std::size_t> failed{0};
+        constexpr std::size_t maxInflight = 32;
+
+        auto perProducer = totalCommands / concurrency;
+        auto startNs = nowNs();
+        std::vector<std::thread> producers;
+        for (std::size_t p = 0; p != concurrency; ++p) {
+            producers.emplace_back([&]() {
+                // the callbacks of this producer capture it, so wait them all before return
+                std::atomic<std::size_t> myCompleted{0};
+                auto cb = [&inflight, &completed, &failed, &myCompleted](const error_info &e) {
+                    if (e) {
+                        failed.fetch_add(1);
+                    }
+                    completed.fetch_add(1);
+                    inflight.fetch_sub(1);
+                    myCompleted.fetch_add(1);
+                };
+                for (std::size_t i = 0; i != perProducer; ++i) {
+                    while (inflight.load() >= maxInflight) {
+                        std::this_thread::yield();
+                    }
+                    auto seq = sequence.fetch_add(1);
+                    inflight.fetch_add(1);
+                    if (PtyBenchMode::setState == mode) {
+                        auto v = seq % 202;
+                        bool direct = v > 100;
+                        auto speed = static_cast<uint8_t>(v % 101);
+                        enqueueNs[VorzeFrame::encodeStateCommand(direct, speed)].store(nowNs());
+                        session->setState(direct, speed, cb);
+                    } else {
+                        auto c = static_cast<uint8_t>(seq);
+                        enqueueNs[c].store(nowNs());
+                        session->sendAsync(VorzeFrame::of(c), cb);
+                    }
+                    if (PtyBenchMode::orderedWait == mode) {
+                        while (myCompleted.load() != i + 1) {
+                            std::this_thread::yield();
+                        }
+                    }
+                }
+                while (myCompleted.load() != perProducer) {
+                    std::this_thread::yield();
+                }
+            });
+        }
+        for (auto &a : producers) {
+            a.join();
+        }
+
+        // wait the written frames reach the master side
+        auto deadline = BenchClock::now() + std::chrono::seconds{2};
+        while (wireBytes.load() < session->getWrittenFrames() * VorzeFrame::Size && BenchClock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds{1});
+        }
+        readerStop.store(true);
+        reader.join();
+
+        auto elapsedS = static_cast<double>(lastWireNs.load() - startNs) / 1e9;
+        if (elapsedS <= 0) {
+            elapsedS = 1e-9;
+        }
+        std::cout << "pty/" << modeName(mode) << "/c" << concurrency << ": "
+                  << completed.load() << " cmds (" << failed.load() << " failed, "
+                  << session->getCoalescedFrames() << " coalesced), "
+                  << static_cast<double>(completed.load()) / elapsedS << " cmds/s, "
+                  << static_cast<double>(wireBytes.load()) / elapsedS << " bytes/s, "
+                  << "enqueue-to-wire p50/p99/p999 "
+                  << wireLatency.percentileUs(0.5) << "/"
+                  << wireLatency.percentileUs(0.99) << "/"
+                  << wireLatency.percentileUs(0.999) << " us, "
+                  << "writes " << session->getWriteBatches()
+                  << std::endl;
+
+        session->close();
+        work.reset();
+        ioc.stop();
+        ioThread.join();
+    }
+
+}
+
+void benchmarkPtyGroup() {
+    constexpr std::size_t ports = 4;
+    constexpr std::size_t fanouts = 2000;
+
+    std::array<PtyPair, ports> ptys;
+    for (auto &a : ptys) {
+        if (!a.open()) {
+            std::cerr << "benchmarkPtyGroup() openpty failed." << std::endl;
+            return;
+        }
+    }
+
+    boost::asio::io_context ioc;
+    auto work = boost::asio::make_work_guard(ioc);
+    std::vector<std::thread> ioThreads;
+    for (std::size_t i = 0; i != 2; ++i) {
+        ioThreads.emplace_back([&ioc]() {
+            ioc.run();
+        });
+    }
+    auto stopIo = [&]() {
+        work.reset();
+        ioc.stop();
+        for (auto &a : ioThreads) {
+            a.join();
+        }
+    };
+
+    auto configLoader = std::make_shared<ConfigLoader>();
+    auto actionModeManager = std::make_shared<ActionModeManager>(
+            configLoader, std::make_shared<TimingWheel>(boost::asio::make_strand(ioc)));
+    std::vector<std::shared_ptr<SerialPortSessionTarget>> members;
+    std::vector<std::string> memberNames;
+    for (auto &a : ptys) {
+        auto session = std::make_shared<SerialPortSessionTarget>(
+                boost::asio::make_strand(ioc), configLoader, actionModeManager);
+        std::promise<error_info> opened;
+        session->init(a.slaveName, [&opened](const error_info &e) {
+            opened.set_value(e);
+        });
+        auto openError = opened.get_future().get();
+        if (openError) {
+            std::cerr << "benchmarkPtyGroup() open " << a.slaveName << " failed: " << openError.message()
+                      << std::endl;
+            stopIo();
+            return;
+        }
+        members.push_back(session);
+        memberNames.push_back(a.slaveName);
+    }
+    auto group = std::make_shared<SerialPortGroup>(
+            boost::asio::make_strand(ioc), "bench", members, memberNames, actionModeManager);
+
+    // drain the master side, so the pty buffer never full
+    std::atomic_bool readerStop{false};
+    std::thread reader([&]() {
+        std::array<pollfd, ports> p{};
+        for (std::size_t i = 0; i != ports; ++i) {
+            p[i] = pollfd{ptys[i].master, POLLIN, 0};
+        }
+        std::array<uint8_t, 4096> buf{};
+        while (!readerStop.load()) {
+            if (::poll(p.data(), p.size(), 50) <= 0) {
+                continue;
+            }
+            for (auto &a : p) {
+                if (a.revents & POLLIN) {
+                    boost::ignore_unused(::read(a.fd, buf.data(), buf.size()));
+                }
+            }
+        }
+    });
+
+    // like a pattern playback, a state change every 2 ms
+    for (std::size_t i = 0; i != fanouts; ++i) {
+        auto speed = static_cast<uint8_t>(1 + i % 100);
+        boost::asio::dispatch(boost::asio::make_strand(ioc), [group, speed, i]() {
+            group->fanout(i % 2 == 0, speed);
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds{2});
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds{100});
+
+    const auto &skew = group->getSkew();
+    std::cout << "pty-group/" << ports << "ports: " << group->getFanouts() << " fanouts, "
+              << skew.getCount() << " measured, skew p50/p99/max "
+              << skew.percentileUs(0.5) << "/"
+              << skew.percentileUs(0.99) << "/"
+              << skew.getMaxUs() << " us" << std::endl;
+
+    readerStop.store(true);
+    reader.join();
+    for (auto &a : members) {
+        a->close();
+    }
+    stopIo();
+}
+
+void benchmarkPtyLoopback() {
+    constexpr std::size_t totalCommands = 20000;
+    for (auto mode : {PtyBenchMode::sendAsync, PtyBenchMode::orderedWait, PtyBenchMode::setState}) {
+        for (std::size_t concurrency : {1, 4, 16}) {
+            runPtyBench(mode, concurrency, totalCommands);
+        }
+    }
+}
+
+#endif // _WIN32
@@ -0,0 +1,47 @@
+/**
+ * VorzeControlServer : A VORZE electric toys Vorze A10 Cyclone/Piston SA Remote Control Adapter Server Powered by Boost.Asio
+ * Copyright (C) 2020 Jeremie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VORZECONTROLSERVER_PTYLOOPBACKBENCHMARK_H
+#define VORZECONTROLSERVER_PTYLOOPBACKBENCHMARK_H
+
+#ifdef MSVC
+#pragma once
+#endif
+
+#ifndef _WIN32
+
+/**
+ * the end-to-end benchmark of the serial path without the physical adapter.
+ *      open a pty pair, attach a SerialPortSession to the slave side, read the frames back from the master side,
+ *      report the throughput and the enqueue-to-wire latency at several concurrency levels.
+ *
+ * run it by `--bench pty`
+ */
+void benchmarkPtyLoopback();
+
+/**
+ * the skew of the group playback : a SerialPortGroup of several pty ports, fan out a state change every 2 ms,
+ *      report the spread of the write complete time between the ports.
+ *
+ * run it by `--bench pty-group`
+ */
+void benchmarkPtyGroup();
+
+#endif // _WIN32
+
+#endif //VORZECONTROLSERVER_PTYLOOPBACKBENCHMARK_H
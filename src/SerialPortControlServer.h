@@ -25,12 +25,14 @@
 
 #include <boost/asio.hpp>
 #include <boost/asio/serial_port.hpp>
+#include <limits>
 #include <memory>
 #include <string>
 #include <sstream>
 #include <map>
-#include <list>
-#include <set>
+#include <unordered_map>
+#include <array>
+#include <atomic>
 #include <tuple>
 #include <utility>
 #include <exception>
@@ -43,11 +45,72 @@
 #include "error_info.h"
 #include "SerialPortFinder.h"
 #include "AsyncDelay.h"
+#include "MpscRing.h"
+#include "VorzeFrame.h"
+#include "LatencyHistogram.h"
+#include "SerialPortHotplugWatcher.h"
+#include "SnapshotRegistry.h"
+
+#ifdef PromiseCpp_FOUND
+
+#include "promise.hpp"
+
+#endif // PromiseCpp_FOUND
 
 
 using SendCompleteCallback = std::function<void(const error_info &ec)>;
 extern SendCompleteCallback noop;
 
+/**
+ * a command waiting in the SerialPortSession command ring.
+ *      the frame point to the static VorzeFrameTable, so the frame is never allocated or copied.
+ *      the cb is moved in, it allocate only when the caller build it,
+ *      a lambda capture more than the std::function small buffer (e.g. a shared_ptr) always need one.
+ */
+struct SerialPortCommand {
+    const VorzeFrame *frame = nullptr;
+    std::chrono::steady_clock::time_point enqueueTime;
+    /**
+     * a speed/direction state command, it can be replaced by a newer state command still pending in the ring
+     */
+    bool coalescible = false;
+    SendCompleteCallback cb;
+};
+
+/**
+ * a ConstBufferSequence over a range of const_buffer that someone else own.
+ *      async_write copy the buffer sequence into its operation, copy this one only copy two pointer,
+ *      a std::vector copy allocate every write.
+ */
+struct ConstBufferRange {
+    const boost::asio::const_buffer *first = nullptr;
+    const boost::asio::const_buffer *last = nullptr;
+
+    using value_type = boost::asio::const_buffer;
+    using const_iterator = const boost::asio::const_buffer *;
+
+    [[nodiscard]]
+    const_iterator begin() const {
+        return first;
+    }
+
+    [[nodiscard]]
+    const_iterator end() const {
+        return last;
+    }
+};
+
+/**
+ * a frame read back from the USB Bluetooth Adapter.
+ *      the adapter answer in the same 3 byte layout of VorzeFrame.
+ */
+struct SerialPortDeviceEvent {
+    std::array<uint8_t, VorzeFrame::Size> bytes{};
+    std::chrono::steady_clock::time_point time;
+};
+
+using DeviceEventCallback = std::function<void(const SerialPortDeviceEvent &event)>;
+
 class SerialPortSession : public std::enable_shared_from_this<SerialPortSession> {
 protected:
     boost::asio::executor ex;
@@ -55,8 +118,60 @@ protected:
     boost::asio::serial_port serialPort;
     std::string serialPortName;
 
-    std::set<std::shared_ptr<std::string>> sendingData;
-    std::mutex sendingDataMtx;
+    static constexpr std::size_t CommandRingCapacity = 64;
+
+    MpscRing<SerialPortCommand, CommandRingCapacity> commandRing;
+    // true when a drain chain is running (or posted) on `ex`
+    std::atomic_bool draining{false};
+    static constexpr std::size_t MaxWriteBatch = 16;
+
+    // the commands in the writing, only touch them in `ex`
+    std::array<SerialPortCommand, MaxWriteBatch> writingBatch;
+    std::size_t writingBatchSize = 0;
+    // the gather buffers of writingBatch, the first writingBatchSize are in the write
+    std::array<boost::asio::const_buffer, MaxWriteBatch> writingBuffers;
+    // wait the flush window before start a batch, let the close-together commands go in one write
+    boost::asio::steady_timer flushTimer;
+    // the per-write timeout, cancel the stalled write, so a stalled USB dongle never hang the drain chain
+    boost::asio::steady_timer writeTimer;
+    // increase on every write, a late fired writeTimer use it to know its write was completed
+    std::size_t writeGeneration = 0;
+    bool writeTimedOut = false;
+    // increase on every open, a delayed close() use it to know the port was reopened
+    std::size_t openGeneration = 0;
+
+    // the last command byte really written to the port (in the write order, set by the write handler),
+    // -1 if unknown (not open yet, or a write fail)
+    std::atomic_int lastCommand{-1};
+    // the commands pushed into commandRing and not completed yet (queued, in writingBatch, or in flight).
+    // lastCommand is the device state only when it is 0
+    std::atomic_size_t pendingCommands{0};
+    std::atomic_size_t stateFrames{0};
+    // the state frame that equal to lastCommand when nothing pending, it not send
+    std::atomic_size_t suppressedFrames{0};
+
+    std::atomic_size_t coalescedFrames{0};
+    std::atomic_size_t writtenFrames{0};
+    std::atomic_size_t writeBatches{0};
+    std::atomic_size_t writeTimeouts{0};
+
+    // the read loop buffer, only touch it in `ex`
+    std::array<uint8_t, 64> readBuffer{};
+    SerialPortDeviceEvent readingEvent;
+    std::size_t readingEventSize = 0;
+    DeviceEventCallback deviceEventCallback;
+    // the enqueue time of the first command in the last written batch, wait the first response byte
+    std::chrono::steady_clock::time_point responsePendingSince;
+    bool responsePending = false;
+
+    std::atomic_size_t receivedBytes{0};
+    std::atomic_size_t deviceEvents{0};
+    // enqueue -> write complete
+    LatencyHistogram writeLatency;
+    // the EWMA of the write latency, the output latency estimate of the mode playback
+    std::atomic<long long int> writeLatencyEwmaUs{0};
+    // enqueue -> first response byte
+    LatencyHistogram responseLatency;
 
 public:
     SerialPortSession(
@@ -66,10 +181,16 @@ public:
     ) : ex(ex),
         configLoader(configLoader),
         serialPort(ex),
-        actionModeManager(actionModeManager) {}
+        flushTimer(ex),
+        writeTimer(ex),
+        actionModeManager(actionModeManager) {
+    }
 
     auto open(const std::string &_serialPortName) -> std::pair<bool, error_info> {
-        close();
+        closeNow();
+        ++openGeneration;
+        lastCommand.store(-1, std::memory_order_relaxed);
+        writeLatencyEwmaUs.store(0, std::memory_order_relaxed);
         serialPortName = _serialPortName;
         boost::system::error_code ec;
         serialPort.open(serialPortName, ec);
@@ -175,103 +296,380 @@ public:
     }
 
 
-    void sendAsync(const std::string &data, const SendCompleteCallback &cb = noop) {
+    /**
+     * @param coalescible   if the coalesce mode enabled (Config::coalesceStateCommand),
+     *                      this command will be dropped when a newer coalescible command queued after it
+     *                      before it start write, the dropped command callback will be called without error.
+     */
+    void sendAsync(const VorzeFrame &frame, SendCompleteCallback cb = noop, bool coalescible = false) {
         if (!serialPort.is_open()) {
             cb({"!serialPort.is_open()"});
             return;
         }
 
-        decltype(std::declval<decltype(sendingData)>().emplace()) refData;
-        {
-            // https://stackoverflow.com/questions/20516773/stdunique-lockstdmutex-or-stdlock-guardstdmutex
-            // https://stackoverflow.com/questions/43019598/stdlock-guard-or-stdscoped-lock
-            std::lock_guard<decltype(sendingDataMtx)> lockGuard{sendingDataMtx};
+        SerialPortCommand c;
+        c.frame = &frame;
+        c.enqueueTime = std::chrono::steady_clock::now();
+        c.coalescible = coalescible && configLoader->config.coalesceStateCommand;
+        c.cb = std::move(cb);
+        // count it before push, so the consumer never complete it before it counted
+        pendingCommands.fetch_add(1, std::memory_order_relaxed);
+        if (!commandRing.tryPush(std::move(c))) {
+            pendingCommands.fetch_sub(1, std::memory_order_release);
+            // a full ring not take the command, c.cb is still here
+            c.cb({"SerialPortSession::sendAsync() command ring overflow."});
+            return;
+        }
+        scheduleDrain();
+    }
+
+#ifdef PromiseCpp_FOUND
+
+    /**
+     * the promise style of sendAsync(), resolve after the frame written, reject on error or timeout
+     */
+    promise::Defer promiseSend(const VorzeFrame &frame, bool coalescible = false) {
+        return promise::newPromise([self = shared_from_this(), this, &frame, coalescible](promise::Defer d) {
+            sendAsync(frame, [d](const error_info &e) {
+                if (e) {
+                    d.reject(e);
+                    return;
+                }
+                d.resolve();
+            }, coalescible);
+        });
+    }
+
+#endif // PromiseCpp_FOUND
+
+    [[nodiscard]]
+    MpscRingState getCommandRingState() const {
+        return commandRing.state();
+    }
+
+    /**
+     * @return the ms between a frame queued and the device react to it :
+     *      the measured write latency (if Config::outputLatencyEstimate) + Config::outputLatencyMs
+     */
+    [[nodiscard]]
+    double getOutputLatencyMs() const {
+        const auto &config = configLoader->config;
+        double ms = config.outputLatencyMs;
+        if (config.outputLatencyEstimate) {
+            ms += static_cast<double>(writeLatencyEwmaUs.load(std::memory_order_relaxed)) / 1000.0;
+        }
+        return ms;
+    }
+
+    [[nodiscard]]
+    std::size_t getStateFrames() const {
+        return stateFrames.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]]
+    std::size_t getSuppressedFrames() const {
+        return suppressedFrames.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @return the suppressed part of all the state frames, in [0, 1]
+     */
+    [[nodiscard]]
+    double getSuppressionRatio() const {
+        auto all = getStateFrames();
+        return all == 0 ? 0.0 : static_cast<double>(getSuppressedFrames()) / static_cast<double>(all);
+    }
+
+    [[nodiscard]]
+    std::size_t getCoalescedFrames() const {
+        return coalescedFrames.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]]
+    std::size_t getWrittenFrames() const {
+        return writtenFrames.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * how many write op issued, writtenFrames / writeBatches is the average frames per write
+     */
+    [[nodiscard]]
+    std::size_t getWriteBatches() const {
+        return writeBatches.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]]
+    std::size_t getWriteTimeouts() const {
+        return writeTimeouts.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]]
+    std::size_t getReceivedBytes() const {
+        return receivedBytes.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]]
+    std::size_t getDeviceEvents() const {
+        return deviceEvents.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]]
+    const LatencyHistogram &getWriteLatency() const {
+        return writeLatency;
+    }
+
+    [[nodiscard]]
+    const LatencyHistogram &getResponseLatency() const {
+        return responseLatency;
+    }
+
+    /**
+     * the callback will be called in `ex` for every frame read from the port
+     */
+    void setDeviceEventCallback(DeviceEventCallback callback) {
+        boost::asio::dispatch(ex, [self = shared_from_this(), this, callback = std::move(callback)]() {
+            deviceEventCallback = callback;
+        });
+    }
+
+protected:
+
+    void scheduleDrain() {
+        // only the producer that flip the flag start the drain chain
+        if (!draining.exchange(true, std::memory_order_acq_rel)) {
+            boost::asio::post(ex, [self = shared_from_this(), this]() {
+                startDrain();
+            });
+        }
+    }
+
+    void startDrain() {
+        auto flushWindow = configLoader->config.serialFlushWindowUs;
+        if (flushWindow == 0) {
+            drainNext();
+            return;
+        }
+        flushTimer.expires_after(std::chrono::microseconds{flushWindow});
+        flushTimer.async_wait([self = shared_from_this(), this](const boost::system::error_code &e) {
+            boost::ignore_unused(e);
+            drainNext();
+        });
+    }
+
+    /**
+     * move the pending commands from commandRing into writingBatch.
+     *      a coalescible command directly follow another coalescible command replace it,
+     *      so the latency of a state command is bounded by one write, not by the queue depth.
+     */
+    void collectWritingBatch() {
+        writingBatchSize = 0;
+        while (auto n = commandRing.peek()) {
+            if (writingBatchSize > 0 && n->coalescible && writingBatch[writingBatchSize - 1].coalescible) {
+                auto &last = writingBatch[writingBatchSize - 1];
+                auto cb = std::move(last.cb);
+                last.cb = nullptr;
+                commandRing.tryPop(last);
+                coalescedFrames.fetch_add(1, std::memory_order_relaxed);
+                pendingCommands.fetch_sub(1, std::memory_order_release);
+                cb({});
+                continue;
+            }
+            if (writingBatchSize == MaxWriteBatch) {
+                break;
+            }
+            commandRing.tryPop(writingBatch[writingBatchSize]);
+            ++writingBatchSize;
+        }
+    }
 
-            // a copy of data, make sure the data alive during write
-            refData = sendingData.emplace(std::make_shared<std::string>(data));
-            if (data.data() == refData.first->get()->data()) {
-                // never into there
-                throw std::exception("SerialPortSession::sendAsync() design error, data copy not work.");
+    void completeWritingBatch(const error_info &ec) {
+        for (std::size_t i = 0; i != writingBatchSize; ++i) {
+            auto cb = std::move(writingBatch[i].cb);
+            writingBatch[i].cb = nullptr;
+            pendingCommands.fetch_sub(1, std::memory_order_release);
+            cb(ec);
+        }
+        writingBatchSize = 0;
+    }
+
+    /**
+     * the single consumer of commandRing, always run in `ex`
+     *      write all the pending commands as one gather write, and only one write in flight,
+     *      so writes never overlap and keep the enqueue order
+     */
+    void drainNext() {
+        for (;;) {
+            collectWritingBatch();
+            if (writingBatchSize == 0) {
+                // the ring is empty now, stop the chain.
+                // a producer may push between the failed pop and the flag reset, so check it again.
+                draining.exchange(false, std::memory_order_acq_rel);
+                if (!commandRing.empty()) {
+                    scheduleDrain();
+                }
+                return;
+            }
+            if (serialPort.is_open()) {
+                break;
             }
+            completeWritingBatch({"!serialPort.is_open()"});
+        }
+
+        for (std::size_t i = 0; i != writingBatchSize; ++i) {
+            writingBuffers[i] = writingBatch[i].frame->buffer();
+        }
+        auto generation = ++writeGeneration;
+        writeTimedOut = false;
+        auto writeTimeoutMs = configLoader->config.serialWriteTimeoutMs;
+        if (writeTimeoutMs > 0) {
+            writeTimer.expires_after(std::chrono::milliseconds{writeTimeoutMs});
+            writeTimer.async_wait([self = shared_from_this(), this, generation](
+                    const boost::system::error_code &e) {
+                if (e || generation != writeGeneration) {
+                    return;
+                }
+                // the write still in flight, cancel it, the write handler will get `operation_aborted`
+                writeTimedOut = true;
+                writeTimeouts.fetch_add(1, std::memory_order_relaxed);
+                boost::system::error_code ec;
+                serialPort.cancel(ec);
+            });
         }
         boost::asio::async_write(
                 serialPort,
-                boost::asio::buffer(*refData.first->get()),
-                [self = shared_from_this(), this, refData, cb](
+                ConstBufferRange{writingBuffers.data(), writingBuffers.data() + writingBatchSize},
+                [self = shared_from_this(), this](
                         const boost::system::error_code &ec, std::size_t bytes_transferred
                 ) {
                     boost::ignore_unused(bytes_transferred);
+                    ++writeGeneration;
+                    boost::system::error_code ect;
+                    writeTimer.cancel(ect);
+                    if (writeTimedOut || ec) {
+                        // the device state is unknown now, dont suppress the next frame
+                        lastCommand.store(-1, std::memory_order_relaxed);
+                    }
+                    if (writeTimedOut) {
+                        std::cerr << "SerialPortSession write timeout on serialPortName:" << serialPortName
+                                  << std::endl;
+                        completeWritingBatch({"SerialPortSession write timeout.", ec});
+                        drainNext();
+                        return;
+                    }
                     if (ec) {
                         // dont care it
+                    } else {
+                        // the tail of the batch is the state of the device now.
+                        // store it before completeWritingBatch() release pendingCommands
+                        lastCommand.store(writingBatch[writingBatchSize - 1].frame->command(),
+                                          std::memory_order_relaxed);
+                        writtenFrames.fetch_add(writingBatchSize, std::memory_order_relaxed);
+                        writeBatches.fetch_add(1, std::memory_order_relaxed);
+                        auto now = std::chrono::steady_clock::now();
+                        auto ewma = writeLatencyEwmaUs.load(std::memory_order_relaxed);
+                        for (std::size_t i = 0; i != writingBatchSize; ++i) {
+                            auto latency = now - writingBatch[i].enqueueTime;
+                            writeLatency.record(latency);
+                            auto us = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+                            // alpha = 1/8
+                            ewma = ewma == 0 ? us : ewma + (us - ewma) / 8;
+                        }
+                        writeLatencyEwmaUs.store(ewma, std::memory_order_relaxed);
+                        if (!responsePending) {
+                            responsePending = true;
+                            responsePendingSince = writingBatch[0].enqueueTime;
+                        }
                     }
-                    {
-                        std::lock_guard<decltype(sendingDataMtx)> lockGuard{sendingDataMtx};
-                        // delete data copy
-                        sendingData.erase(refData.first);
+                    completeWritingBatch(ec);
+                    drainNext();
+                });
+    }
+
+public:
+
+    /**
+     * the read loop, one async_read_some in flight per open port, run in `ex`
+     */
+    void startRead() {
+        serialPort.async_read_some(
+                boost::asio::buffer(readBuffer),
+                [self = shared_from_this(), this, generation = openGeneration](
+                        const boost::system::error_code &ec, std::size_t bytes_transferred
+                ) {
+                    if (generation != openGeneration) {
+                        // the port reopened, the new open start its own read loop
+                        return;
+                    }
+                    if (ec) {
+                        // a write timeout cancel all op on the port, include this read
+                        if (boost::asio::error::operation_aborted == ec && serialPort.is_open()) {
+                            startRead();
+                        }
+                        return;
                     }
-                    cb(ec);
+                    onRead(bytes_transferred);
+                    startRead();
                 });
     }
 
-    void sendSync(const std::string &data, const SendCompleteCallback &cb = noop) {
-        if (!serialPort.is_open()) {
-            cb({"!serialPort.is_open()"});
-            return;
+    void onRead(std::size_t bytes_transferred) {
+        auto now = std::chrono::steady_clock::now();
+        receivedBytes.fetch_add(bytes_transferred, std::memory_order_relaxed);
+        if (responsePending && bytes_transferred > 0) {
+            responsePending = false;
+            responseLatency.record(now - responsePendingSince);
         }
-
-        decltype(std::declval<decltype(sendingData)>().emplace()) refData;
-        {
-            // https://stackoverflow.com/questions/20516773/stdunique-lockstdmutex-or-stdlock-guardstdmutex
-            // https://stackoverflow.com/questions/43019598/stdlock-guard-or-stdscoped-lock
-            std::lock_guard<decltype(sendingDataMtx)> lockGuard{sendingDataMtx};
-            // a copy of data, make sure the data alive during write
-            refData = sendingData.emplace(std::make_shared<std::string>(data));
-            if (data.data() == refData.first->get()->data()) {
-                // never into there
-                throw std::exception("SerialPortSession::sendSync() design error, data copy not work.");
+        for (std::size_t i = 0; i != bytes_transferred; ++i) {
+            if (readingEventSize == 0) {
+                readingEvent.time = now;
             }
-        }
-        // call sync or async
-        // to keep write op run in same thread
-        // try-inline run, if the caller same in the `ex`
-        boost::asio::dispatch(ex, [self = shared_from_this(), this, refData, cb]() {
-            if (!serialPort.is_open()) {
-                cb({"!serialPort.is_open()"});
-                return;
+            readingEvent.bytes[readingEventSize++] = readBuffer[i];
+            if (readingEventSize == readingEvent.bytes.size()) {
+                readingEventSize = 0;
+                deviceEvents.fetch_add(1, std::memory_order_relaxed);
+                if (deviceEventCallback) {
+                    deviceEventCallback(readingEvent);
+                }
             }
+        }
+    }
+
+    void closeNow() {
+        if (serialPort.is_open()) {
             boost::system::error_code ec;
-            std::size_t bytes_transferred = boost::asio::write(
-                    serialPort,
-                    boost::asio::buffer(*refData.first->get()),
-                    ec);
-            boost::ignore_unused(bytes_transferred);
+            serialPort.close(ec);
             if (ec) {
-                // dont care it
-            }
-            {
-                std::lock_guard<decltype(sendingDataMtx)> lockGuard{sendingDataMtx};
-                // delete data copy
-                sendingData.erase(refData.first);
+                std::cerr << "setBaudRate::close() error on serialPortName:" << serialPortName
+                          << " error:" << ec.message() << std::endl;
             }
-            cb(ec);
-        });
+        }
     }
 
-    void close() {
-        if (serialPort.is_open()) {
-            // send end op
-            stop([self = shared_from_this(), this](const error_info &) {
-
-                // then close it
-                boost::system::error_code ec;
-                serialPort.close(ec);
-                if (ec) {
-                    std::cerr << "setBaudRate::close() error on serialPortName:" << serialPortName
-                              << " error:" << ec.message() << std::endl;
-                }
+public:
 
+    /**
+     * send the stop frame, then close the port after it written (or failed/timeout).
+     *      the stop frame go through the command ring, so it is ordered after all the queued frames,
+     *      and never block the io thread.
+     */
+    void close() {
+        boost::asio::dispatch(ex, [self = shared_from_this(), this]() {
+            if (!serialPort.is_open()) {
+                stopActionSession();
+                return;
+            }
+            stopActionSession([self = shared_from_this(), this, generation = openGeneration]() {
+                // send end op
+                stop([self = shared_from_this(), this, generation](const error_info &) {
+                    boost::asio::dispatch(ex, [self = shared_from_this(), this, generation]() {
+                        // then close it, if it not reopened during the stop frame in queue
+                        if (generation == openGeneration) {
+                            closeNow();
+                        }
+                    });
+                });
             });
-        }
+        });
     }
 
 public:
@@ -284,6 +682,9 @@ public:
                 auto rVo = open(_serialPortName);
                 if (rVo.first) {
                     setBaudRate(19200);
+                    readingEventSize = 0;
+                    responsePending = false;
+                    startRead();
                 }
                 cb(rVo.second);
             };
@@ -296,42 +697,72 @@ public:
         });
     }
 
-    void stop(const SendCompleteCallback &cb = noop) {
-        sendCommand(0, cb);
+    void stop(SendCompleteCallback cb = noop) {
+        sendCommand(0, std::move(cb));
     }
 
-    void sendCommand(unsigned char c, const SendCompleteCallback &cb = noop, bool async = false) {
+    void sendCommand(unsigned char c, SendCompleteCallback cb = noop, bool coalescible = false) {
         if (is_open()) {
-            std::array<unsigned char, 3> dataBuf{1, 1, 0};
-            dataBuf[2] = c;
-            if (async) {
-                sendAsync(std::string{(char *) dataBuf.data(), dataBuf.size()}, cb);
-            } else {
-                sendSync(std::string{(char *) dataBuf.data(), dataBuf.size()}, cb);
-            }
+            sendAsync(VorzeFrame::of(c), std::move(cb), coalescible);
         } else {
             cb({"!serialPort.is_open()"});
             return;
         }
     }
 
-    void setState(bool direct = true, uint8_t speed = 0, const SendCompleteCallback &cb = noop) {
+    /**
+     * the frame equal to the last command byte written to the port is suppressed when no command pending,
+     * the cb called without error
+     */
+    void setState(bool direct = true, uint8_t speed = 0, SendCompleteCallback cb = noop) {
         if (!is_open()) {
             cb({"!serialPort.is_open()"});
             return;
         }
-        if (speed > 100) {
-            speed = 100;
-        }
-        if (speed >= 0x80) {
-            speed = 0;
+        auto c = VorzeFrame::encodeStateCommand(direct, speed);
+        stateFrames.fetch_add(1, std::memory_order_relaxed);
+        if (isStateCommandSuppressed(c)) {
+            suppressedFrames.fetch_add(1, std::memory_order_relaxed);
+            cb({});
+            return;
         }
-        sendCommand(static_cast<uint8_t>(direct ? 0x80 : 0x00) + speed, cb, true);
+        sendCommand(c, std::move(cb), true);
+    }
+
+    /**
+     * @return true if setState(direct, speed) will be suppressed now, because the port already in this state
+     */
+    [[nodiscard]]
+    bool isStateSuppressed(bool direct, uint8_t speed) const {
+        return isStateCommandSuppressed(VorzeFrame::encodeStateCommand(direct, speed));
+    }
+
+    /**
+     * a pending command may change the state after lastCommand, so only trust lastCommand when nothing pending
+     */
+    [[nodiscard]]
+    bool isStateCommandSuppressed(uint8_t command) const {
+        return pendingCommands.load(std::memory_order_acquire) == 0
+               && lastCommand.load(std::memory_order_relaxed) == command;
     }
 
 protected:
 
     std::shared_ptr<ActionModeManager> actionModeManager;
+    // the running mode playback, only replace it in `ex`, use std::atomic_load to read it from other thread
+    std::shared_ptr<ActionSession> actionSession;
+
+    /**
+     * @param then  called after the playback stopped, so the frame send in it never be overwrite by the playback
+     */
+    void stopActionSession(const std::function<void()> &then = {}) {
+        if (auto s = std::atomic_load(&actionSession)) {
+            s->stop(then);
+            std::atomic_store(&actionSession, std::shared_ptr<ActionSession>{});
+        } else if (then) {
+            then();
+        }
+    }
 
 public:
     void setState(
@@ -339,13 +770,63 @@ public:
             bool direct = true,
             uint8_t speed = 0,
             const SendCompleteCallback &cb = noop) {
-        if ("none" == mode) {
-            setState(direct, speed, cb);
-            return;
-        }
-        // TODO the mode manager
-        actionModeManager->init(mode, ex);
-        // TODO init timer and callback chain
+        boost::asio::dispatch(ex, [self = shared_from_this(), this, mode, direct, speed, cb]() {
+            if ("none" == mode) {
+                stopActionSession([self = shared_from_this(), this, direct, speed, cb]() {
+                    setState(direct, speed, cb);
+                });
+                return;
+            }
+            auto s = actionModeManager->init(mode, ex, direct);
+            if (!s) {
+                cb({"mode not found : " + mode});
+                return;
+            }
+            stopActionSession();
+            std::atomic_store(&actionSession, s);
+            // the ActionSession call it on every state change, from the TimingWheel
+            s->start([self = weak_from_this()](const ActionItem &item) {
+                if (auto ptr = self.lock()) {
+                    ptr->setState(item.direct != 0, item.speed);
+                }
+            }, [self = weak_from_this()]() {
+                auto ptr = self.lock();
+                return ptr ? ptr->getOutputLatencyMs() : 0.0;
+            });
+            cb({});
+        });
+    }
+
+    /**
+     * sync the running mode playback to a external player clock, see ActionSession::sync()
+     */
+    void syncAction(double positionMs, double rate, const SendCompleteCallback &cb = noop) {
+        boost::asio::dispatch(ex, [self = shared_from_this(), this, positionMs, rate, cb]() {
+            auto s = std::atomic_load(&actionSession);
+            if (!s) {
+                cb({"no mode playing"});
+                return;
+            }
+            s->sync(positionMs, rate);
+            cb({});
+        });
+    }
+
+    /**
+     * @return the running mode playback, or nullptr, it is safe to call from any thread
+     */
+    [[nodiscard]]
+    std::shared_ptr<ActionSession> getActionSession() const {
+        return std::atomic_load(&actionSession);
+    }
+
+    /**
+     * stop the mode playback of this port only, e.g. the port join a group that will drive it
+     */
+    void stopMode(const std::function<void()> &then = {}) {
+        boost::asio::dispatch(ex, [self = shared_from_this(), this, then]() {
+            stopActionSession(then);
+        });
     }
 
 };
@@ -353,6 +834,257 @@ public:
 
 using SerialPortSessionTarget = SerialPortSession;
 
+/**
+ * a group of ports driven by one timeline.
+ *      one ActionSession (so one TimingWheel tick) fan out every state change to all the members back to back,
+ *      instead of a ActionSession and a timer per port, so the members never drift apart.
+ *      the skew (the spread of the write complete time between the members of one fan out) is measured.
+ */
+class SerialPortGroup : public std::enable_shared_from_this<SerialPortGroup> {
+    boost::asio::executor ex;
+    std::string name;
+    // immutable, a group with other members is a new group
+    std::vector<std::shared_ptr<SerialPortSessionTarget>> members;
+    // the registry key of every member, same order as members, the other strand read them instead of the sessions
+    std::vector<std::string> memberNames;
+    std::shared_ptr<ActionModeManager> actionModeManager;
+
+    // the running mode playback, only replace it in `ex`, use std::atomic_load to read it from other thread
+    std::shared_ptr<ActionSession> actionSession;
+
+    std::atomic_size_t fanouts{0};
+    // the write complete time spread of the members in one fan out
+    LatencyHistogram skew;
+
+    /**
+     * the write complete time of the members in one fan out, the last one record the spread
+     */
+    struct FanoutTracker {
+        std::shared_ptr<SerialPortGroup> group;
+        std::chrono::steady_clock::time_point issueTime;
+        std::atomic_size_t remaining{0};
+        std::atomic<long long int> minUs{std::numeric_limits<long long int>::max()};
+        std::atomic<long long int> maxUs{0};
+        std::atomic_size_t written{0};
+
+        void complete(const error_info &e) {
+            if (!e) {
+                auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - issueTime).count();
+                auto m = minUs.load(std::memory_order_relaxed);
+                while (us < m && !minUs.compare_exchange_weak(m, us, std::memory_order_relaxed)) {
+                }
+                m = maxUs.load(std::memory_order_relaxed);
+                while (us > m && !maxUs.compare_exchange_weak(m, us, std::memory_order_relaxed)) {
+                }
+                written.fetch_add(1, std::memory_order_relaxed);
+            }
+            release();
+        }
+
+        void release() {
+            if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1 && written.load() >= 2) {
+                group->skew.recordUs(static_cast<uint64_t>(maxUs.load() - minUs.load()));
+            }
+        }
+    };
+
+public:
+    SerialPortGroup(
+            boost::asio::executor ex,
+            std::string name,
+            std::vector<std::shared_ptr<SerialPortSessionTarget>> members,
+            std::vector<std::string> memberNames,
+            std::shared_ptr<ActionModeManager> actionModeManager
+    ) : ex(ex),
+        name(std::move(name)),
+        members(std::move(members)),
+        memberNames(std::move(memberNames)),
+        actionModeManager(actionModeManager) {}
+
+    [[nodiscard]]
+    const std::string &getName() const {
+        return name;
+    }
+
+    [[nodiscard]]
+    const std::vector<std::shared_ptr<SerialPortSessionTarget>> &getMembers() const {
+        return members;
+    }
+
+    /**
+     * immutable, safe to read from any thread
+     */
+    [[nodiscard]]
+    const std::vector<std::string> &getMemberNames() const {
+        return memberNames;
+    }
+
+    [[nodiscard]]
+    std::size_t getFanouts() const {
+        return fanouts.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]]
+    const LatencyHistogram &getSkew() const {
+        return skew;
+    }
+
+    [[nodiscard]]
+    std::shared_ptr<ActionSession> getActionSession() const {
+        return std::atomic_load(&actionSession);
+    }
+
+    /**
+     * set the state of all the members, the members are written back to back, the skew is measured.
+     *      the member that already in the state is skipped (see SerialPortSession::isStateSuppressed).
+     */
+    void fanout(bool direct, uint8_t speed) {
+        fanouts.fetch_add(1, std::memory_order_relaxed);
+        auto tracker = std::make_shared<FanoutTracker>();
+        tracker->group = shared_from_this();
+        tracker->issueTime = std::chrono::steady_clock::now();
+        // the guard, so the tracker not finish before all the members issued
+        tracker->remaining.store(1, std::memory_order_relaxed);
+        for (const auto &m : members) {
+            if (!m->is_open() || m->isStateSuppressed(direct, speed)) {
+                m->setState(direct, speed);
+                continue;
+            }
+            tracker->remaining.fetch_add(1, std::memory_order_relaxed);
+            m->setState(direct, speed, [tracker](const error_info &e) {
+                tracker->complete(e);
+            });
+        }
+        tracker->release();
+    }
+
+    /**
+     * like SerialPortSession::setState(mode, ...), but drive all the members
+     */
+    void setState(
+            std::string mode,
+            bool direct = true,
+            uint8_t speed = 0,
+            const SendCompleteCallback &cb = noop) {
+        boost::asio::dispatch(ex, [self = shared_from_this(), this, mode, direct, speed, cb]() {
+            if ("none" == mode) {
+                stopActionSession([self = shared_from_this(), this, direct, speed, cb]() {
+                    fanout(direct, speed);
+                    cb({});
+                });
+                return;
+            }
+            auto s = actionModeManager->init(mode, ex, direct);
+            if (!s) {
+                cb({"mode not found : " + mode});
+                return;
+            }
+            stopActionSession();
+            for (const auto &m : members) {
+                // the group drive them now
+                m->stopMode();
+            }
+            std::atomic_store(&actionSession, s);
+            s->start([self = weak_from_this()](const ActionItem &item) {
+                if (auto ptr = self.lock()) {
+                    ptr->fanout(item.direct != 0, item.speed);
+                }
+            }, [self = weak_from_this()]() {
+                // play for the slowest member
+                auto ptr = self.lock();
+                double ms = 0;
+                if (ptr) {
+                    for (const auto &m : ptr->members) {
+                        ms = std::max(ms, m->getOutputLatencyMs());
+                    }
+                }
+                return ms;
+            });
+            cb({});
+        });
+    }
+
+    /**
+     * see ActionSession::sync()
+     */
+    void syncAction(double positionMs, double rate, const SendCompleteCallback &cb = noop) {
+        boost::asio::dispatch(ex, [self = shared_from_this(), this, positionMs, rate, cb]() {
+            auto s = std::atomic_load(&actionSession);
+            if (!s) {
+                cb({"no mode playing"});
+                return;
+            }
+            s->sync(positionMs, rate);
+            cb({});
+        });
+    }
+
+    /**
+     * stop the playback, and stop all the members
+     */
+    void stop() {
+        boost::asio::dispatch(ex, [self = shared_from_this(), this]() {
+            stopActionSession([self = shared_from_this(), this]() {
+                fanout(true, 0);
+            });
+        });
+    }
+
+private:
+    void stopActionSession(const std::function<void()> &then = {}) {
+        if (auto s = std::atomic_load(&actionSession)) {
+            s->stop(then);
+            std::atomic_store(&actionSession, std::shared_ptr<ActionSession>{});
+        } else if (then) {
+            then();
+        }
+    }
+};
+
+/**
+ * the immutable port list published by the SerialPortControlServer,
+ *      the `index` map the comName to the position in `list`
+ */
+struct PortsInfoSnapshot {
+    std::vector<SerialPortNameInfo> list;
+    std::unordered_map<std::string, std::size_t> index;
+    // the change from the previous snapshot, a port that its info changed is in both
+    std::vector<SerialPortNameInfo> added;
+    std::vector<SerialPortNameInfo> removed;
+
+    PortsInfoSnapshot() = default;
+
+    /**
+     * @param ports     sorted by comName, as SerialPortFinder::find() give
+     * @param previous  the snapshot it replace, sorted by comName too
+     */
+    PortsInfoSnapshot(std::vector<SerialPortNameInfo> ports, const PortsInfoSnapshot &previous)
+            : list(std::move(ports)) {
+        index.reserve(list.size());
+        for (std::size_t i = 0; i != list.size(); ++i) {
+            index.emplace(list[i].comName, i);
+        }
+        // merge the two sorted list
+        auto o = previous.list.begin();
+        auto n = list.begin();
+        while (o != previous.list.end() || n != list.end()) {
+            if (n == list.end() || (o != previous.list.end() && o->comName < n->comName)) {
+                removed.push_back(*o++);
+            } else if (o == previous.list.end() || n->comName < o->comName) {
+                added.push_back(*n++);
+            } else {
+                if (*o != *n) {
+                    removed.push_back(*o);
+                    added.push_back(*n);
+                }
+                ++o;
+                ++n;
+            }
+        }
+    }
+};
+
 
 class SerialPortControlServer : public std::enable_shared_from_this<SerialPortControlServer> {
     boost::asio::executor ex;
@@ -360,11 +1092,29 @@ class SerialPortControlServer : public std::enable_shared_from_this<SerialPortCo
     std::shared_ptr<ActionModeManager> actionModeManager;
     std::shared_ptr<SerialPortFinder> serialPortFinder;
 
-    std::list<std::shared_ptr<SerialPortSessionTarget>> sessions;
+    // key is the port name, the web strand read it and the serial strand write it, so it must be snapshot
+    SnapshotRegistry<std::shared_ptr<SerialPortSessionTarget>> sessions;
+    // the same sessions keyed by the port id, for the binary control channel
+    SnapshotRegistry<std::shared_ptr<SerialPortSessionTarget>, uint16_t> sessionsById;
+    // a port name keep its id until the server exit, 0 is never used
+    std::unordered_map<std::string, uint16_t> portIds;
+    uint16_t nextPortId = 1;
+    std::mutex portIdsMtx;
+    // key is the group name
+    SnapshotRegistry<std::shared_ptr<SerialPortGroup>> groups;
+
+    // only access it by std::atomic_load/std::atomic_store
+    std::shared_ptr<const PortsInfoSnapshot> portsInfo = std::make_shared<const PortsInfoSnapshot>();
 
-    std::vector<SerialPortNameInfo> portsInfo;
+    // increase when the port list or the open sessions changed, the status document is rebuilt on it
+    std::atomic<uint64_t> stateVersion{1};
 
     std::shared_ptr<boost::asio::steady_timer> timer;
+    // the port list poll interval, it become longer if the hotplug watcher work, the poll is only a fallback
+    std::chrono::milliseconds pollInterval;
+#ifndef _WIN32
+    std::shared_ptr<SerialPortHotplugWatcher> hotplugWatcher;
+#endif // _WIN32
 public:
 
     SerialPortControlServer(boost::asio::executor ex,
@@ -375,12 +1125,29 @@ public:
             configLoader(configLoader),
             actionModeManager(actionModeManager),
             serialPortFinder(serialPortFinder),
-            timer(std::make_shared<boost::asio::steady_timer>
-                          (ex, std::chrono::milliseconds{5000})) {
+            timer(std::make_shared<boost::asio::steady_timer>(ex)),
+            pollInterval(configLoader->config.portPollIntervalMs) {
     }
 
 public:
     void start() {
+#ifndef _WIN32
+        hotplugWatcher = std::make_shared<SerialPortHotplugWatcher>(
+                ex, configLoader->config.devRoot, configLoader->config.sysfsRoot);
+        std::weak_ptr<SerialPortControlServer> weak = shared_from_this();
+        if (hotplugWatcher->start([weak]() {
+            if (auto self = weak.lock()) {
+                self->serialPortFinder->invalidateCache();
+                self->rescanPortInfo();
+            }
+        })) {
+            pollInterval = std::chrono::milliseconds{configLoader->config.portPollIntervalWithHotplugMs};
+        } else {
+            std::cerr << "SerialPortControlServer hotplug watcher not available, fall back to poll." << std::endl;
+            hotplugWatcher.reset();
+        }
+#endif // _WIN32
+        timer->expires_after(pollInterval);
         flushPortInfo();
         // TODO
     }
@@ -392,14 +1159,20 @@ public:
             timer->cancel(ec);
             timer.reset();
         }
+#ifndef _WIN32
+        if (hotplugWatcher) {
+            hotplugWatcher->stop();
+            hotplugWatcher.reset();
+        }
+#endif // _WIN32
         stopAll();
     }
 
-    void flushPortInfo() {
+    void rescanPortInfo() {
 #ifdef PromiseCpp_FOUND
         serialPortFinder->promiseFind().then(
                 [self = shared_from_this(), this](const std::vector<SerialPortNameInfo> &ports) {
-                    portsInfo = ports;
+                    setPortsInfo(ports);
                 });
 #else // ^^^ PromiseCpp_FOUND / PromiseCpp not FOUND vvv
         serialPortFinder->find(
@@ -407,69 +1180,229 @@ public:
                     if (e) {
                         return;
                     }
-                    portsInfo = ports;
-                })
+                    setPortsInfo(ports);
+                });
 #endif // PromiseCpp_FOUND
+    }
+
+    void flushPortInfo() {
+        rescanPortInfo();
 
         auto c = [self = shared_from_this(), this](const boost::system::error_code &e) {
-            if (e) {
+            if (e || !timer) {
                 return;
             }
-            timer->expires_at(timer->expiry() + std::chrono::milliseconds{5000});
+            timer->expires_at(timer->expiry() + pollInterval);
             flushPortInfo();
         };
         timer->async_wait(c);
     }
 
-    const std::vector<SerialPortNameInfo> &getPortsInfo() {
-        return portsInfo;
+    /**
+     * @return the id of the port, a new one for a new name, 0 if the ids run out
+     */
+    uint16_t assignPortId(const std::string &_serialPortName) {
+        std::lock_guard lg{portIdsMtx};
+        auto it = portIds.find(_serialPortName);
+        if (it != portIds.end()) {
+            return it->second;
+        }
+        if (nextPortId == 0) {
+            return 0;
+        }
+        auto id = nextPortId++;
+        portIds.emplace(_serialPortName, id);
+        return id;
     }
 
-    bool checkNameValid(const std::string &_serialPortName) {
-        return portsInfo.end() != std::find_if(
-                portsInfo.begin(), portsInfo.end(),
-                [&_serialPortName](const auto &a) {
-                    return a.comName == _serialPortName;
-                });
+    void setPortsInfo(const std::vector<SerialPortNameInfo> &ports) {
+        auto previous = getPortsInfo();
+        if (previous->list == ports) {
+            // the periodic rescan found nothing new
+            return;
+        }
+        auto now = std::make_shared<const PortsInfoSnapshot>(ports, *previous);
+        for (const auto &a : now->removed) {
+            std::cout << "SerialPortControlServer port removed: " << a.comName
+                      << " (" << a.userFriendlyName << ")" << std::endl;
+        }
+        for (const auto &a : now->added) {
+            std::cout << "SerialPortControlServer port added: " << a.comName
+                      << " (" << a.userFriendlyName << ")" << std::endl;
+        }
+        std::atomic_store(&portsInfo, std::shared_ptr<const PortsInfoSnapshot>{now});
+        stateVersion.fetch_add(1, std::memory_order_release);
+    }
+
+    [[nodiscard]]
+    uint64_t getStateVersion() const {
+        return stateVersion.load(std::memory_order_acquire);
+    }
+
+    std::shared_ptr<const PortsInfoSnapshot> getPortsInfo() const {
+        return std::atomic_load(&portsInfo);
     }
 
+    bool checkNameValid(const std::string &_serialPortName) const {
+        auto pi = getPortsInfo();
+        return pi->index.find(_serialPortName) != pi->index.end();
+    }
+
+    /**
+     * @return the new session, or the exist one if other request create it first. empty if the name invalid
+     */
     std::shared_ptr<SerialPortSessionTarget> create(
             const std::string &_serialPortName
     ) {
         if (!checkNameValid(_serialPortName)) {
             return {};
         }
-        auto s = std::make_shared<SerialPortSessionTarget>(ex, configLoader, actionModeManager);
-        sessions.push_back(s->shared_from_this());
-        s->init(_serialPortName);
-        return s;
+        auto r = sessions.update([this, &_serialPortName](auto &m) {
+            auto it = m.find(_serialPortName);
+            if (it != m.end()) {
+                return std::make_pair(it->second, false);
+            }
+            auto s = std::make_shared<SerialPortSessionTarget>(ex, configLoader, actionModeManager);
+            m.emplace(_serialPortName, s);
+            return std::make_pair(s, true);
+        });
+        if (r.second) {
+            auto id = assignPortId(_serialPortName);
+            if (id != 0) {
+                sessionsById.update([id, s = r.first](auto &m) {
+                    m[id] = s;
+                });
+            }
+            r.first->init(_serialPortName);
+            stateVersion.fetch_add(1, std::memory_order_release);
+        }
+        return r.first;
     }
 
-    std::shared_ptr<SerialPortSessionTarget> get(const std::string &_serialPortName) {
-        auto it = std::find_if(
-                sessions.begin(), sessions.end(),
-                [_serialPortName](const decltype(sessions)::value_type &a) {
-                    return a->getSerialPortName() == _serialPortName;
-                }
-        );
-        return (it != sessions.end() ? *it : std::shared_ptr<SerialPortSessionTarget>{});
+    std::shared_ptr<SerialPortSessionTarget> get(const std::string &_serialPortName) const {
+        return sessions.find(_serialPortName);
     }
 
-    std::vector<std::string> listOpenPortsName() {
+    std::shared_ptr<SerialPortSessionTarget> getById(uint16_t portId) const {
+        return sessionsById.find(portId);
+    }
+
+    /**
+     * @return the id of the port, 0 if it was never opened
+     */
+    uint16_t getPortId(const std::string &_serialPortName) {
+        std::lock_guard lg{portIdsMtx};
+        auto it = portIds.find(_serialPortName);
+        return it != portIds.end() ? it->second : 0;
+    }
+
+    decltype(sessions)::Snapshot sessionsSnapshot() const {
+        return sessions.snapshot();
+    }
+
+    std::vector<std::shared_ptr<SerialPortSessionTarget>> listSessions() const {
+        auto ss = sessions.snapshot();
+        std::vector<std::shared_ptr<SerialPortSessionTarget>> r;
+        r.reserve(ss->size());
+        for (const auto &a: *ss) {
+            r.push_back(a.second);
+        }
+        return r;
+    }
+
+    std::vector<std::string> listOpenPortsName() const {
+        auto ss = sessions.snapshot();
         std::vector<std::string> names;
-        for (const auto &a: sessions) {
-            names.push_back(a->getSerialPortName());
+        names.reserve(ss->size());
+        for (const auto &a: *ss) {
+            names.push_back(a.first);
         }
         return names;
     }
 
+    /**
+     * create (or replace) the group, all the members must be a open session
+     * @return the group, or empty and the error
+     */
+    std::pair<std::shared_ptr<SerialPortGroup>, error_info> createGroup(
+            const std::string &groupName,
+            const std::vector<std::string> &memberNames
+    ) {
+        if (groupName.empty() || memberNames.empty()) {
+            return {{}, {"group need a name and members"}};
+        }
+        std::vector<std::shared_ptr<SerialPortSessionTarget>> members;
+        std::vector<std::string> names;
+        members.reserve(memberNames.size());
+        names.reserve(memberNames.size());
+        for (const auto &n : memberNames) {
+            auto s = get(n);
+            if (!s) {
+                return {{}, {"group member not open : " + n}};
+            }
+            if (std::find(members.begin(), members.end(), s) == members.end()) {
+                members.push_back(s);
+                names.push_back(n);
+            }
+        }
+        auto g = std::make_shared<SerialPortGroup>(
+                ex, groupName, std::move(members), std::move(names), actionModeManager);
+        auto old = groups.update([&groupName, &g](auto &m) {
+            auto &slot = m[groupName];
+            auto o = slot;
+            slot = g;
+            return o;
+        });
+        if (old) {
+            old->stop();
+        }
+        return {g, {}};
+    }
+
+    std::shared_ptr<SerialPortGroup> getGroup(const std::string &groupName) const {
+        return groups.find(groupName);
+    }
+
+    decltype(groups)::Snapshot groupsSnapshot() const {
+        return groups.snapshot();
+    }
+
+    void removeGroup(const std::string &groupName) {
+        auto old = groups.update([&groupName](auto &m) {
+            std::shared_ptr<SerialPortGroup> o;
+            auto it = m.find(groupName);
+            if (it != m.end()) {
+                o = it->second;
+                m.erase(it);
+            }
+            return o;
+        });
+        if (old) {
+            old->stop();
+        }
+    }
+
     void stopAll() {
-        for (auto &a: sessions) {
-            if (a) {
-                a->close();
+        decltype(groups)::Map oldGroups;
+        groups.update([&oldGroups](auto &m) {
+            oldGroups.swap(m);
+        });
+        for (auto &a: oldGroups) {
+            if (a.second) {
+                a.second->stop();
+            }
+        }
+        decltype(sessions)::Map old;
+        sessions.update([&old](auto &m) {
+            old.swap(m);
+        });
+        sessionsById.replace({});
+        stateVersion.fetch_add(1, std::memory_order_release);
+        for (auto &a: old) {
+            if (a.second) {
+                a.second->close();
             }
         }
-        sessions.clear();
     }
 
 };
@@ -24,16 +24,28 @@
 #endif
 
 #include <memory>
+#include <atomic>
 #include <regex>
 #include <algorithm>
 #include <functional>
 #include <vector>
+#include <map>
 #include <iostream>
 #include <sstream>
+#include <fstream>
 #include <boost/asio.hpp>
+#include "error_info.h"
+
+#ifdef _WIN32
+
 #include "wmi.hpp"
 #include "wmiclasses.hpp"
-#include "error_info.h"
+
+#else // ^^^ _WIN32 / not _WIN32 vvv
+
+#include <boost/filesystem.hpp>
+
+#endif // _WIN32
 
 #ifdef PromiseCpp_FOUND
 
@@ -41,6 +53,8 @@
 
 #endif // PromiseCpp_FOUND
 
+#ifdef _WIN32
+
 struct Win32_PnPEntity {
     std::string Name;
 
@@ -69,9 +83,14 @@ struct Win32_SerialPort {
 
 using TargetWmi = Win32_SerialPort;
 
+#endif // _WIN32
+
 struct SerialPortNameInfo {
     std::string userFriendlyName;
     std::string comName;
+    // the USB idVendor/idProduct, empty if unknown
+    std::string vendorId;
+    std::string productId;
 
     SerialPortNameInfo() = default;
 
@@ -79,63 +98,75 @@ struct SerialPortNameInfo {
             std::string userFriendlyName,
             std::string comName
     ) : userFriendlyName(userFriendlyName), comName(comName) {}
+
+    bool operator==(const SerialPortNameInfo &o) const {
+        return comName == o.comName && userFriendlyName == o.userFriendlyName &&
+               vendorId == o.vendorId && productId == o.productId;
+    }
+
+    bool operator!=(const SerialPortNameInfo &o) const {
+        return !(*this == o);
+    }
 };
 
 class SerialPortFinder : public std::enable_shared_from_this<SerialPortFinder> {
     boost::asio::executor ex;
+    // the root of sysfs and dev, can point to a fake tree
+    std::string sysfsRoot;
+    std::string devRoot;
+
+#ifndef _WIN32
+    struct SysfsTtyCacheEntry {
+        // the resolved `device` link of the entry, a other adapter take the same tty name have a other one
+        std::string device;
+        // empty if it is not a usable serial port
+        std::shared_ptr<SerialPortNameInfo> info;
+    };
+    // the scanned `class/tty` entry, key is the tty name.
+    // a known entry never read its attribute files again while its device not change,
+    // so a refresh only cost a directory scan and a readlink.
+    std::map<std::string, SysfsTtyCacheEntry> sysfsTtyCache;
+    // set by invalidateCache() from any thread, the next scan drop the whole cache
+    std::atomic_bool sysfsTtyCacheStale{false};
+#endif // _WIN32
+
 public:
     SerialPortFinder(
-            boost::asio::executor ex
-    ) : ex(ex) {}
+            boost::asio::executor ex,
+            std::string sysfsRoot = "/sys",
+            std::string devRoot = "/dev"
+    ) : ex(ex),
+        sysfsRoot(std::move(sysfsRoot)),
+        devRoot(std::move(devRoot)) {}
 
     using FindCallback = std::function<void(const std::vector<SerialPortNameInfo> &ports, const error_info &e)>;
 
+    /**
+     * @param callback  the ports sorted by comName, so two scan of the same ports compare equal
+     */
     void find(FindCallback callback) {
         // non-block
-        boost::asio::post(ex, [callback]() {
+        boost::asio::post(ex, [self = shared_from_this(), this, callback]() {
             std::vector<SerialPortNameInfo> ports;
-            try {
-
-                auto wmis = Wmi::retrieveAllWmi<TargetWmi>();
-                // from https://github.com/Net005/Vorze-PlayerHelper/blob/master/Libraries/Cyclone2/Devices/UsbDongle.cs
-                std::regex regexFind{R"(\((COM[1-9][0-9]?[0-9]?)\)$)"};
-                std::regex regexGet{R"(.*\((COM[1-9][0-9]?[0-9]?)\)$)"};
-                decltype(wmis) wmif;
-                std::copy_if(wmis.begin(), wmis.end(), std::back_inserter(wmif),
-                             [&regexFind](const TargetWmi &service) {
-                                 return std::regex_search(service.Name, regexFind);
-                             });
-                // std::cout << "\n";
-                // std::cout << "wmis" << "\n";
-                // for (const TargetWmi &service : wmis) {
-                //     std::cout << service.Name << std::endl;
-                // }
-
-                // std::cout << "\n";
-                // std::cout << "wmif" << "\n";
-                for (const TargetWmi &service : wmif) {
-                    // std::cout << service.Name << std::endl;
-                    std::smatch sm;
-                    std::regex_match(service.Name, sm, regexGet);
-                    // std::cout << sm[1].str() << std::endl;
-                    ports.emplace_back(service.Name, sm[1].str());
-                }
-
-            } catch (const Wmi::WmiException &ex) {
-                error_info ei;
-                std::stringstream ss;
-                ss << "Wmi error: " << ex.errorMessage << ", Code: " << ex.hexErrorCode();
-                ei.info = ss.str();
-                std::cerr << ei.info << std::endl;
-
-                callback(ports, ei);
-                return;
-            }
-            callback(ports, error_info{});
-            return;
+            auto ei = scanPorts(ports);
+            // the directory (or WMI) order is not stable
+            std::sort(ports.begin(), ports.end(), [](const SerialPortNameInfo &a, const SerialPortNameInfo &b) {
+                return a.comName < b.comName;
+            });
+            callback(ports, ei);
         });
     }
 
+    /**
+     * a hotplug event call it, the same adapter path may now hold a other device (re-plug between two scan),
+     *      so the next scan read all the attribute files again
+     */
+    void invalidateCache() {
+#ifndef _WIN32
+        sysfsTtyCacheStale.store(true, std::memory_order_relaxed);
+#endif // _WIN32
+    }
+
 #ifdef PromiseCpp_FOUND
 
     promise::Defer promiseFind() {
@@ -151,6 +182,133 @@ public:
     }
 
 #endif // PromiseCpp_FOUND
+
+protected:
+
+#ifdef _WIN32
+
+    error_info scanPorts(std::vector<SerialPortNameInfo> &ports) {
+        try {
+
+            auto wmis = Wmi::retrieveAllWmi<TargetWmi>();
+            // from https://github.com/Net005/Vorze-PlayerHelper/blob/master/Libraries/Cyclone2/Devices/UsbDongle.cs
+            static const std::regex regexGet{R"(.*\((COM[1-9][0-9]?[0-9]?)\)$)"};
+            for (const TargetWmi &service : wmis) {
+                std::smatch sm;
+                if (std::regex_match(service.Name, sm, regexGet)) {
+                    ports.emplace_back(service.Name, sm[1].str());
+                }
+            }
+
+        } catch (const Wmi::WmiException &ex) {
+            error_info ei;
+            std::stringstream ss;
+            ss << "Wmi error: " << ex.errorMessage << ", Code: " << ex.hexErrorCode();
+            ei.info = ss.str();
+            std::cerr << ei.info << std::endl;
+            return ei;
+        }
+        return {};
+    }
+
+#else // ^^^ _WIN32 / not _WIN32 vvv
+
+    static std::string readSysfsAttribute(const boost::filesystem::path &p) {
+        std::ifstream f{p.string()};
+        std::string s;
+        std::getline(f, s);
+        return s;
+    }
+
+    /**
+     * read a `class/tty/<name>` entry
+     * @return empty if it is not a usable serial port (no device, or a legacy `platform` ttyS)
+     */
+    std::shared_ptr<SerialPortNameInfo> readSysfsTty(const boost::filesystem::path &entry, const std::string &name) {
+        namespace fs = boost::filesystem;
+        boost::system::error_code ec;
+
+        auto device = entry / "device";
+        if (!fs::exists(device, ec)) {
+            // the virtual terminal, e.g. tty0 ptmx console
+            return {};
+        }
+        // same as pyserial, the `platform` ttyS always exist even no hardware behind it
+        auto subsystem = fs::read_symlink(device / "subsystem", ec);
+        if (!ec && subsystem.filename() == "platform") {
+            return {};
+        }
+
+        auto info = std::make_shared<SerialPortNameInfo>();
+        info->comName = (fs::path{devRoot} / name).string();
+        info->userFriendlyName = name;
+
+        // walk up to the usb device node that hold the idVendor/idProduct
+        auto root = fs::canonical(sysfsRoot, ec);
+        auto p = fs::canonical(device, ec);
+        if (ec) {
+            p = device;
+        }
+        for (; !p.empty() && p != root && p != p.root_path(); p = p.parent_path()) {
+            if (fs::exists(p / "idVendor", ec) && fs::exists(p / "idProduct", ec)) {
+                info->vendorId = readSysfsAttribute(p / "idVendor");
+                info->productId = readSysfsAttribute(p / "idProduct");
+                auto manufacturer = readSysfsAttribute(p / "manufacturer");
+                auto product = readSysfsAttribute(p / "product");
+                std::stringstream ss;
+                if (!manufacturer.empty()) {
+                    ss << manufacturer << " ";
+                }
+                if (!product.empty()) {
+                    ss << product << " ";
+                }
+                ss << "(" << name << ")";
+                info->userFriendlyName = ss.str();
+                break;
+            }
+        }
+        return info;
+    }
+
+    error_info scanPorts(std::vector<SerialPortNameInfo> &ports) {
+        namespace fs = boost::filesystem;
+        boost::system::error_code ec;
+
+        auto ttyDir = fs::path{sysfsRoot} / "class" / "tty";
+        fs::directory_iterator it{ttyDir, ec};
+        if (ec) {
+            std::stringstream ss;
+            ss << "SerialPortFinder::scanPorts() cannot open " << ttyDir.string() << " error:" << ec.message();
+            error_info ei{ss.str(), ec};
+            std::cerr << ei.info << std::endl;
+            return ei;
+        }
+
+        if (sysfsTtyCacheStale.exchange(false, std::memory_order_relaxed)) {
+            sysfsTtyCache.clear();
+        }
+        decltype(sysfsTtyCache) nowCache;
+        for (; it != fs::directory_iterator{}; it.increment(ec)) {
+            if (ec) {
+                break;
+            }
+            auto name = it->path().filename().string();
+            boost::system::error_code ecd;
+            auto device = fs::canonical(it->path() / "device", ecd).string();
+            auto c = sysfsTtyCache.find(name);
+            auto info = c != sysfsTtyCache.end() && c->second.device == device
+                        ? c->second.info
+                        : readSysfsTty(it->path(), name);
+            if (info) {
+                ports.push_back(*info);
+            }
+            nowCache.emplace(name, SysfsTtyCacheEntry{std::move(device), std::move(info)});
+        }
+        sysfsTtyCache.swap(nowCache);
+        return {};
+    }
+
+#endif // _WIN32
 };
 
 
@@ -0,0 +1,163 @@
+/**
+ * VorzeControlServer : A VORZE electric toys Vorze A10 Cyclone/Piston SA Remote Control Adapter Server Powered by Boost.Asio
+ * Copyright (C) 2020 Jeremie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "SerialPortHotplugWatcher.h"
+
+#ifndef _WIN32
+
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <unistd.h>
+#include <cstring>
+#include <iostream>
+#include <string_view>
+
+namespace {
+    bool isSerialPortNodeName(std::string_view name) {
+        return name.substr(0, 3) == "tty" || name.substr(0, 6) == "rfcomm";
+    }
+}
+
+bool SerialPortHotplugWatcher::start(ChangeCallback changeCallback) {
+    callback = std::move(changeCallback);
+    bool inotifyOk = openInotify();
+    bool ueventOk = openUevent();
+    if (inotifyOk) {
+        readInotify();
+    }
+    if (ueventOk) {
+        readUevent();
+    }
+    return inotifyOk || ueventOk;
+}
+
+void SerialPortHotplugWatcher::stop() {
+    boost::system::error_code ec;
+    inotifyStream.close(ec);
+    ueventStream.close(ec);
+    debounceTimer.cancel(ec);
+}
+
+bool SerialPortHotplugWatcher::openInotify() {
+    int fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "SerialPortHotplugWatcher inotify_init1 error:" << std::strerror(errno) << std::endl;
+        return false;
+    }
+    constexpr uint32_t mask = IN_CREATE | IN_DELETE | IN_ATTRIB | IN_MOVED_FROM | IN_MOVED_TO;
+    int watched = 0;
+    if (::inotify_add_watch(fd, devRoot.c_str(), mask) >= 0) {
+        ++watched;
+    }
+    // sysfs mostly not support inotify, but a fake tree may, it cost nothing to try
+    if (::inotify_add_watch(fd, (sysfsRoot + "/class/tty").c_str(), mask) >= 0) {
+        ++watched;
+    }
+    if (watched == 0) {
+        std::cerr << "SerialPortHotplugWatcher inotify_add_watch error:" << std::strerror(errno) << std::endl;
+        ::close(fd);
+        return false;
+    }
+    inotifyStream.assign(fd);
+    return true;
+}
+
+bool SerialPortHotplugWatcher::openUevent() {
+    int fd = ::socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+    if (fd < 0) {
+        std::cerr << "SerialPortHotplugWatcher netlink socket error:" << std::strerror(errno) << std::endl;
+        return false;
+    }
+    sockaddr_nl addr{};
+    addr.nl_family = AF_NETLINK;
+    // the kernel uevent multicast group
+    addr.nl_groups = 1;
+    if (::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+        std::cerr << "SerialPortHotplugWatcher netlink bind error:" << std::strerror(errno) << std::endl;
+        ::close(fd);
+        return false;
+    }
+    ueventStream.assign(fd);
+    return true;
+}
+
+void SerialPortHotplugWatcher::readInotify() {
+    inotifyStream.async_read_some(
+            boost::asio::buffer(inotifyBuffer),
+            [self = shared_from_this(), this](const boost::system::error_code &ec, std::size_t n) {
+                if (ec) {
+                    return;
+                }
+                bool hit = false;
+                std::size_t pos = 0;
+                while (pos + sizeof(inotify_event) <= n) {
+                    inotify_event e{};
+                    std::memcpy(&e, inotifyBuffer.data() + pos, sizeof(e));
+                    if (e.mask & IN_Q_OVERFLOW) {
+                        // the kernel queue overflowed and dropped events, a port may have changed unseen
+                        hit = true;
+                    } else if (e.len > 0) {
+                        std::string_view name{inotifyBuffer.data() + pos + sizeof(inotify_event)};
+                        hit = hit || isSerialPortNodeName(name);
+                    }
+                    pos += sizeof(inotify_event) + e.len;
+                }
+                if (hit) {
+                    trigger();
+                }
+                readInotify();
+            });
+}
+
+void SerialPortHotplugWatcher::readUevent() {
+    ueventStream.async_read_some(
+            boost::asio::buffer(ueventBuffer),
+            [self = shared_from_this(), this](const boost::system::error_code &ec, std::size_t n) {
+                if (ec) {
+                    return;
+                }
+                // the message is `ACTION@DEVPATH\0KEY=VALUE\0...`
+                std::string_view msg{ueventBuffer.data(), n};
+                if (msg.find(std::string_view{"SUBSYSTEM=tty\0", 14}) != std::string_view::npos ||
+                    msg.find("SUBSYSTEM=usb-serial") != std::string_view::npos) {
+                    trigger();
+                }
+                readUevent();
+            });
+}
+
+void SerialPortHotplugWatcher::trigger() {
+    events.fetch_add(1, std::memory_order_relaxed);
+    if (debouncing) {
+        return;
+    }
+    debouncing = true;
+    debounceTimer.expires_after(DebounceTime);
+    debounceTimer.async_wait([self = shared_from_this(), this](const boost::system::error_code &ec) {
+        debouncing = false;
+        if (ec) {
+            return;
+        }
+        if (callback) {
+            callback();
+        }
+    });
+}
+
+#endif // _WIN32
@@ -0,0 +1,102 @@
+/**
+ * VorzeControlServer : A VORZE electric toys Vorze A10 Cyclone/Piston SA Remote Control Adapter Server Powered by Boost.Asio
+ * Copyright (C) 2020 Jeremie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VORZECONTROLSERVER_SERIALPORTHOTPLUGWATCHER_H
+#define VORZECONTROLSERVER_SERIALPORTHOTPLUGWATCHER_H
+
+#ifdef MSVC
+#pragma once
+#endif
+
+#ifndef _WIN32
+
+#include <boost/asio.hpp>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+
+/**
+ * watch the serial port hotplug event, so the SerialPortControlServer only rescan when something changed.
+ *      the kernel uevent (netlink) tell us the tty add/remove on sysfs,
+ *      the inotify on `/dev` tell us the device node created/deleted by udev.
+ *      both fd run in the io_context as stream_descriptor, a burst of event only trigger one callback.
+ */
+class SerialPortHotplugWatcher : public std::enable_shared_from_this<SerialPortHotplugWatcher> {
+public:
+    using ChangeCallback = std::function<void()>;
+
+    // a burst of event (e.g. one dongle create many node) merge in this window
+    static constexpr std::chrono::milliseconds DebounceTime{20};
+
+private:
+    boost::asio::executor ex;
+    std::string devRoot;
+    std::string sysfsRoot;
+
+    boost::asio::posix::stream_descriptor inotifyStream;
+    boost::asio::posix::stream_descriptor ueventStream;
+    boost::asio::steady_timer debounceTimer;
+    std::array<char, 4096> inotifyBuffer{};
+    std::array<char, 8192> ueventBuffer{};
+    bool debouncing = false;
+
+    ChangeCallback callback;
+
+    std::atomic_size_t events{0};
+
+public:
+    SerialPortHotplugWatcher(
+            boost::asio::executor ex,
+            std::string devRoot,
+            std::string sysfsRoot
+    ) : ex(ex),
+        devRoot(std::move(devRoot)),
+        sysfsRoot(std::move(sysfsRoot)),
+        inotifyStream(ex),
+        ueventStream(ex),
+        debounceTimer(ex) {}
+
+    /**
+     * @return false if no event source available, the caller must fall back to polling
+     */
+    bool start(ChangeCallback changeCallback);
+
+    void stop();
+
+    [[nodiscard]]
+    std::size_t getEvents() const {
+        return events.load(std::memory_order_relaxed);
+    }
+
+private:
+    bool openInotify();
+
+    bool openUevent();
+
+    void readInotify();
+
+    void readUevent();
+
+    void trigger();
+};
+
+#endif // _WIN32
+
+#endif //VORZECONTROLSERVER_SERIALPORTHOTPLUGWATCHER_H
@@ -0,0 +1,101 @@
+/**
+ * VorzeControlServer : A VORZE electric toys Vorze A10 Cyclone/Piston SA Remote Control Adapter Server Powered by Boost.Asio
+ * Copyright (C) 2020 Jeremie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VORZECONTROLSERVER_SNAPSHOTREGISTRY_H
+#define VORZECONTROLSERVER_SNAPSHOTREGISTRY_H
+
+#ifdef MSVC
+#pragma once
+#endif
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+/**
+ * a read-mostly registry keyed by name (or other key, e.g. a id) (RCU style).
+ *      the readers grab the current immutable snapshot without take the writer lock, then look it up in O(1).
+ *      it is not lock-free : std::atomic_load/std::atomic_store of a shared_ptr take a short global spinlock
+ *      (a hashed pool in libstdc++, a single one in MSVC) around the refcount update,
+ *      so a reader never wait a writer's copy, but may spin on another load or store.
+ *      the writers serialized by the mutex, copy the snapshot, modify the copy, then publish it.
+ *      a reader that still hold a old snapshot never see it changed.
+ */
+template<typename V, typename K = std::string>
+class SnapshotRegistry {
+public:
+    using Map = std::unordered_map<K, V>;
+    using Snapshot = std::shared_ptr<const Map>;
+
+private:
+    // only access it by std::atomic_load/std::atomic_store
+    Snapshot current = std::make_shared<const Map>();
+    std::mutex writerMtx;
+
+public:
+
+    [[nodiscard]]
+    Snapshot snapshot() const {
+        return std::atomic_load(&current);
+    }
+
+    /**
+     * @return the value, or a default constructed V if not found
+     */
+    [[nodiscard]]
+    V find(const K &key) const {
+        auto s = snapshot();
+        auto it = s->find(key);
+        return it != s->end() ? it->second : V{};
+    }
+
+    [[nodiscard]]
+    bool contains(const K &key) const {
+        auto s = snapshot();
+        return s->find(key) != s->end();
+    }
+
+    /**
+     * @param f     `R(Map &)` modify the copy of current snapshot, the copy will be published after f return
+     * @return      what f return
+     */
+    template<typename F>
+    auto update(F &&f) {
+        std::lock_guard<std::mutex> lg{writerMtx};
+        auto next = std::make_shared<Map>(*snapshot());
+        if constexpr (std::is_void_v<decltype(f(*next))>) {
+            f(*next);
+            std::atomic_store(&current, Snapshot{std::move(next)});
+        } else {
+            auto r = f(*next);
+            std::atomic_store(&current, Snapshot{std::move(next)});
+            return r;
+        }
+    }
+
+    void replace(Map m) {
+        std::lock_guard<std::mutex> lg{writerMtx};
+        std::atomic_store(&current, Snapshot{std::make_shared<const Map>(std::move(m))});
+    }
+};
+
+
+#endif //VORZECONTROLSERVER_SNAPSHOTREGISTRY_H
@@ -0,0 +1,290 @@
+/**
+ * VorzeControlServer : A VORZE electric toys Vorze A10 Cyclone/Piston SA Remote Control Adapter Server Powered by Boost.Asio
+ * Copyright (C) 2020 Jeremie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "TimingWheel.h"
+
+#include <algorithm>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif // _MSC_VER
+
+namespace {
+    unsigned countTrailingZeros(uint64_t v) {
+#ifdef _MSC_VER
+        unsigned long r;
+        _BitScanForward64(&r, v);
+        return static_cast<unsigned>(r);
+#else
+        return static_cast<unsigned>(__builtin_ctzll(v));
+#endif // _MSC_VER
+    }
+
+    /**
+     * @return the distance d in [0, 63] that the bit `(from + d) % 64` is the first set bit, bits must not be 0
+     */
+    unsigned nextSetBitDistance(uint64_t bits, unsigned from) {
+        auto rotated = from == 0 ? bits : ((bits >> from) | (bits << (64 - from)));
+        return countTrailingZeros(rotated);
+    }
+}
+
+TimingWheelHandle TimingWheel::schedule(std::chrono::milliseconds delay, Callback callback) {
+    // the wheel not move when it is empty or sleep, catch up before use currentTick,
+    // but not when called by a callback, the tick in process is not finished yet
+    if (!processing) {
+        advance(nowTick());
+    }
+
+    // round the expire time up to the tick, so a timer never fire early
+    auto expire = Clock::now() - startTime + delay;
+    auto expireTick = static_cast<uint64_t>(std::chrono::ceil<std::chrono::milliseconds>(expire).count());
+
+    auto i = allocNode();
+    auto &n = nodes[i];
+    n.expireTick = std::max(expireTick, currentTick + 1);
+    n.callback = std::move(callback);
+    n.active = true;
+    link(i);
+    ++pending;
+    if (!processing) {
+        // onTimer() arm it after the tick
+        arm();
+    }
+    return TimingWheelHandle{i, n.generation};
+}
+
+bool TimingWheel::cancel(TimingWheelHandle &handle) {
+    if (!handle || handle.index >= nodes.size()) {
+        return false;
+    }
+    auto &n = nodes[handle.index];
+    bool r = false;
+    if (n.active && n.generation == handle.generation) {
+        drop(handle.index);
+        --pending;
+        r = true;
+    }
+    handle = TimingWheelHandle{};
+    return r;
+}
+
+void TimingWheel::clear() {
+    for (std::size_t i = 0; i != nodes.size(); ++i) {
+        if (nodes[i].active) {
+            drop(static_cast<uint32_t>(i));
+        }
+    }
+    pending = 0;
+    boost::system::error_code ec;
+    timer.cancel(ec);
+    armedTick = 0;
+}
+
+uint64_t TimingWheel::nowTick() const {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            Clock::now() - startTime).count());
+}
+
+uint32_t TimingWheel::allocNode() {
+    if (!freeNodes.empty()) {
+        auto i = freeNodes.back();
+        freeNodes.pop_back();
+        return i;
+    }
+    nodes.emplace_back();
+    return static_cast<uint32_t>(nodes.size() - 1);
+}
+
+void TimingWheel::freeNode(uint32_t i) {
+    auto &n = nodes[i];
+    n.active = false;
+    n.due = false;
+    n.callback = nullptr;
+    // make the old handle invalid
+    ++n.generation;
+    freeNodes.push_back(i);
+}
+
+void TimingWheel::link(uint32_t i) {
+    auto &n = nodes[i];
+    // find the lowest level that the expire tick fall in its 64 slot window
+    unsigned level = Levels - 1;
+    uint64_t bucket = (currentTick >> (LevelBits * level)) + SlotsPerLevel;
+    for (unsigned l = 0; l != Levels; ++l) {
+        auto shift = LevelBits * l;
+        if ((n.expireTick >> shift) - (currentTick >> shift) <= SlotsPerLevel) {
+            level = l;
+            bucket = n.expireTick >> shift;
+            break;
+        }
+    }
+    // a too far timer park in the farthest slot of last level, it will re-insert when that slot cascade
+
+    auto slot = static_cast<unsigned>(bucket & (SlotsPerLevel - 1));
+    n.level = static_cast<uint8_t>(level);
+    n.slot = static_cast<uint8_t>(slot);
+    n.prev = Invalid;
+    n.next = heads[level][slot];
+    if (n.next != Invalid) {
+        nodes[n.next].prev = i;
+    }
+    heads[level][slot] = i;
+    occupied[level] |= (uint64_t{1} << slot);
+}
+
+void TimingWheel::unlink(uint32_t i) {
+    auto &n = nodes[i];
+    if (n.prev != Invalid) {
+        nodes[n.prev].next = n.next;
+    } else {
+        heads[n.level][n.slot] = n.next;
+    }
+    if (n.next != Invalid) {
+        nodes[n.next].prev = n.prev;
+    }
+    if (heads[n.level][n.slot] == Invalid) {
+        occupied[n.level] &= ~(uint64_t{1} << n.slot);
+    }
+    n.prev = Invalid;
+    n.next = Invalid;
+}
+
+void TimingWheel::drop(uint32_t i) {
+    // a due node is already out of its slot, the new generation make processTick() skip it
+    if (!nodes[i].due) {
+        unlink(i);
+    }
+    freeNode(i);
+}
+
+uint32_t TimingWheel::detachSlot(unsigned level, unsigned slot) {
+    auto h = heads[level][slot];
+    heads[level][slot] = Invalid;
+    occupied[level] &= ~(uint64_t{1} << slot);
+    return h;
+}
+
+uint64_t TimingWheel::nextEventTick() const {
+    uint64_t best = 0;
+    for (unsigned l = 0; l != Levels; ++l) {
+        if (occupied[l] == 0) {
+            continue;
+        }
+        auto shift = LevelBits * l;
+        // the slot of a level hold the bucket in [current + 1, current + 64]
+        auto from = (currentTick >> shift) + 1;
+        auto d = nextSetBitDistance(occupied[l], static_cast<unsigned>(from & (SlotsPerLevel - 1)));
+        auto t = (from + d) << shift;
+        if (best == 0 || t < best) {
+            best = t;
+        }
+    }
+    return best;
+}
+
+void TimingWheel::advance(uint64_t targetTick) {
+    processing = true;
+    while (currentTick < targetTick) {
+        auto next = nextEventTick();
+        if (next == 0 || next > targetTick) {
+            // nothing happen in between, jump
+            currentTick = targetTick;
+            break;
+        }
+        currentTick = next;
+        processTick();
+    }
+    processing = false;
+}
+
+void TimingWheel::processTick() {
+    // cascade the higher level slot that begin at this tick, from high to low
+    for (unsigned l = Levels - 1; l != 0; --l) {
+        auto shift = LevelBits * l;
+        if ((currentTick & ((uint64_t{1} << shift) - 1)) != 0) {
+            continue;
+        }
+        auto slot = static_cast<unsigned>((currentTick >> shift) & (SlotsPerLevel - 1));
+        auto i = detachSlot(l, slot);
+        while (i != Invalid) {
+            auto next = nodes[i].next;
+            link(i);
+            i = next;
+        }
+    }
+
+    auto slot = static_cast<unsigned>(currentTick & (SlotsPerLevel - 1));
+    auto i = detachSlot(0, slot);
+    // collect first, the callback may schedule or cancel other timer
+    dueNodes.clear();
+    while (i != Invalid) {
+        auto next = nodes[i].next;
+        auto &n = nodes[i];
+        if (n.expireTick <= currentTick) {
+            n.prev = Invalid;
+            n.next = Invalid;
+            n.due = true;
+            dueNodes.push_back(TimingWheelHandle{i, n.generation});
+        } else {
+            link(i);
+        }
+        i = next;
+    }
+    for (const auto &d : dueNodes) {
+        auto &n = nodes[d.index];
+        if (!n.active || n.generation != d.generation) {
+            // canceled by a earlier callback, the index may be reused by a new timer
+            continue;
+        }
+        auto cb = std::move(n.callback);
+        freeNode(d.index);
+        --pending;
+        fired.fetch_add(1, std::memory_order_relaxed);
+        if (cb) {
+            cb();
+        }
+    }
+}
+
+void TimingWheel::arm() {
+    auto next = nextEventTick();
+    if (next == 0) {
+        return;
+    }
+    if (armedTick != 0 && armedTick <= next) {
+        // the armed timer will wake up early enough
+        return;
+    }
+    armedTick = next;
+    timer.expires_at(startTime + std::chrono::milliseconds{next});
+    timer.async_wait([self = shared_from_this(), this, next](const boost::system::error_code &ec) {
+        if (ec || armedTick != next) {
+            // canceled, or re-armed to a earlier tick
+            return;
+        }
+        onTimer();
+    });
+}
+
+void TimingWheel::onTimer() {
+    wakeups.fetch_add(1, std::memory_order_relaxed);
+    armedTick = 0;
+    advance(nowTick());
+    arm();
+}
@@ -0,0 +1,181 @@
+/**
+ * VorzeControlServer : A VORZE electric toys Vorze A10 Cyclone/Piston SA Remote Control Adapter Server Powered by Boost.Asio
+ * Copyright (C) 2020 Jeremie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VORZECONTROLSERVER_TIMINGWHEEL_H
+#define VORZECONTROLSERVER_TIMINGWHEEL_H
+
+#ifdef MSVC
+#pragma once
+#endif
+
+#include <boost/asio.hpp>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <vector>
+
+struct TimingWheelHandle {
+    uint32_t index = std::numeric_limits<uint32_t>::max();
+    uint32_t generation = 0;
+
+    explicit operator bool() const {
+        return index != std::numeric_limits<uint32_t>::max();
+    }
+};
+
+/**
+ * a hierarchical timing wheel with millisecond tick, share by all the ActionSession of a io_context.
+ *      4 level, 64 slot per level, a slot of level `l` is 64^l ms, so it cover 2^24 ms (~4.6 hours) directly,
+ *      a longer timer park in the last level and re-insert when it cascade down.
+ *
+ *      only one steady_timer, it armed to the next non-empty slot (found by the slot bitmap),
+ *      so a tick only touch the timer that due, and a empty wheel never wake up.
+ *
+ * NOTE: all the member function must be called in `ex` (it is a strand), the callback called in `ex` too.
+ */
+class TimingWheel : public std::enable_shared_from_this<TimingWheel> {
+public:
+    using Callback = std::function<void()>;
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr unsigned LevelBits = 6;
+    static constexpr unsigned SlotsPerLevel = 1u << LevelBits;
+    static constexpr unsigned Levels = 4;
+
+private:
+    static constexpr uint32_t Invalid = std::numeric_limits<uint32_t>::max();
+
+    struct Node {
+        uint64_t expireTick = 0;
+        Callback callback;
+        uint32_t prev = Invalid;
+        uint32_t next = Invalid;
+        uint32_t generation = 0;
+        uint8_t level = 0;
+        uint8_t slot = 0;
+        bool active = false;
+        // taken out of its slot by processTick(), waiting its callback
+        bool due = false;
+    };
+
+    boost::asio::executor ex;
+    boost::asio::steady_timer timer;
+    const Clock::time_point startTime;
+
+    // the tick that all the slot before it was processed
+    uint64_t currentTick = 0;
+    // the tick that the timer armed to, 0 if not armed
+    uint64_t armedTick = 0;
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> freeNodes;
+    std::array<std::array<uint32_t, SlotsPerLevel>, Levels> heads;
+    std::array<uint64_t, Levels> occupied{};
+    std::size_t pending = 0;
+
+    // true while advance() running, a callback that schedule a timer must not advance the wheel again
+    bool processing = false;
+    // the timer due on the tick in process, reused by every tick
+    std::vector<TimingWheelHandle> dueNodes;
+
+    std::atomic_size_t fired{0};
+    std::atomic_size_t wakeups{0};
+
+public:
+    explicit TimingWheel(boost::asio::executor ex)
+            : ex(ex),
+              timer(ex),
+              startTime(Clock::now()) {
+        for (auto &l : heads) {
+            l.fill(Invalid);
+        }
+    }
+
+    [[nodiscard]]
+    boost::asio::executor getExecutor() const {
+        return ex;
+    }
+
+    /**
+     * @param delay     the callback called after this delay, a zero delay fire on the next tick
+     */
+    TimingWheelHandle schedule(std::chrono::milliseconds delay, Callback callback);
+
+    /**
+     * @return false if the timer was fired or canceled
+     */
+    bool cancel(TimingWheelHandle &handle);
+
+    /**
+     * cancel all timer, drop their callback
+     */
+    void clear();
+
+    [[nodiscard]]
+    std::size_t getPending() const {
+        return pending;
+    }
+
+    [[nodiscard]]
+    std::size_t getFired() const {
+        return fired.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]]
+    std::size_t getWakeups() const {
+        return wakeups.load(std::memory_order_relaxed);
+    }
+
+private:
+    [[nodiscard]]
+    uint64_t nowTick() const;
+
+    uint32_t allocNode();
+
+    void freeNode(uint32_t i);
+
+    void link(uint32_t i);
+
+    void unlink(uint32_t i);
+
+    // cancel a active node, it may be a due node that not in any slot
+    void drop(uint32_t i);
+
+    uint32_t detachSlot(unsigned level, unsigned slot);
+
+    /**
+     * @return the tick of the next slot (fire or cascade) that need process, 0 if the wheel is empty
+     */
+    [[nodiscard]]
+    uint64_t nextEventTick() const;
+
+    void advance(uint64_t targetTick);
+
+    void processTick();
+
+    void arm();
+
+    void onTimer();
+};
+
+
+#endif //VORZECONTROLSERVER_TIMINGWHEEL_H
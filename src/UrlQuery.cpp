@@ -0,0 +1,125 @@
+/**
+ * VorzeControlServer : A VORZE electric toys Vorze A10 Cyclone/Piston SA Remote Control Adapter Server Powered by Boost.Asio
+ * Copyright (C) 2020 Jeremie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "UrlQuery.h"
+
+#include <string>
+
+namespace {
+    int hexValue(char c) {
+        if (c >= '0' && c <= '9') {
+            return c - '0';
+        }
+        if (c >= 'a' && c <= 'f') {
+            return c - 'a' + 10;
+        }
+        if (c >= 'A' && c <= 'F') {
+            return c - 'A' + 10;
+        }
+        return -1;
+    }
+}
+
+std::string_view UrlQuery::pathOf(std::string_view target) {
+    auto path = target.substr(0, target.find('?'));
+    while (path.size() > 1 && path.back() == '/') {
+        path.remove_suffix(1);
+    }
+    if (path.empty()) {
+        path = target.substr(0, 1) == "/" ? target.substr(0, 1) : std::string_view{};
+    }
+    return path;
+}
+
+error_info UrlQuery::parse(std::string_view target) {
+    paramCount = 0;
+    arenaUsed = 0;
+
+    path = pathOf(target);
+    auto q = target.find('?');
+    if (q == std::string_view::npos) {
+        return {};
+    }
+
+    auto query = target.substr(q + 1);
+    // a fragment never send to server, but ignore it anyway
+    query = query.substr(0, query.find('#'));
+
+    // one pass : split on `&`, remember the first `=` and if the part need decode
+    std::size_t begin = 0;
+    std::size_t eq = std::string_view::npos;
+    bool escaped = false;
+    for (std::size_t i = 0; i <= query.size(); ++i) {
+        auto c = i == query.size() ? '&' : query[i];
+        if (c == '=' && eq == std::string_view::npos) {
+            eq = i;
+        } else if (c == '%' || c == '+') {
+            escaped = true;
+        } else if (c == '&') {
+            if (i != begin) {
+                if (paramCount == MaxParams) {
+                    return error_info{"UrlQuery too many params"};
+                }
+                auto part = query.substr(begin, i - begin);
+                auto &p = params[paramCount];
+                if (eq == std::string_view::npos) {
+                    p.key = part;
+                    p.value = {};
+                } else {
+                    p.key = part.substr(0, eq - begin);
+                    p.value = part.substr(eq - begin + 1);
+                }
+                if (escaped && (!decode(p.key, p.key) || !decode(p.value, p.value))) {
+                    return error_info{"UrlQuery bad param : " + std::string{part}};
+                }
+                ++paramCount;
+            }
+            begin = i + 1;
+            eq = std::string_view::npos;
+            escaped = false;
+        }
+    }
+    return {};
+}
+
+bool UrlQuery::decode(std::string_view in, std::string_view &out) {
+    auto begin = arenaUsed;
+    for (std::size_t i = 0; i != in.size(); ++i) {
+        if (arenaUsed == arena.size()) {
+            return false;
+        }
+        auto c = in[i];
+        if (c == '+') {
+            c = ' ';
+        } else if (c == '%') {
+            if (i + 2 >= in.size()) {
+                return false;
+            }
+            auto h = hexValue(in[i + 1]);
+            auto l = hexValue(in[i + 2]);
+            if (h < 0 || l < 0) {
+                return false;
+            }
+            c = static_cast<char>(h * 16 + l);
+            i += 2;
+        }
+        arena[arenaUsed++] = c;
+    }
+    out = std::string_view{arena.data() + begin, arenaUsed - begin};
+    return true;
+}
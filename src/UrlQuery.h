@@ -0,0 +1,119 @@
+/**
+ * VorzeControlServer : A VORZE electric toys Vorze A10 Cyclone/Piston SA Remote Control Adapter Server Powered by Boost.Asio
+ * Copyright (C) 2020 Jeremie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VORZECONTROLSERVER_URLQUERY_H
+#define VORZECONTROLSERVER_URLQUERY_H
+
+#ifdef MSVC
+#pragma once
+#endif
+
+#include <array>
+#include <cstddef>
+#include <string_view>
+#include "error_info.h"
+
+struct UrlQueryParam {
+    std::string_view key;
+    std::string_view value;
+};
+
+/**
+ * parse a request target like `/op?_targetCOM=COM3&_targetMode=sine%3Aperiod%3D4s` in place, without heap allocation.
+ *      the path and the params view the target, a param that need percent-decode is decoded into a fixed arena,
+ *      so the target must outlive it.
+ *
+ *      a param without `=` have a empty value, the value of a param is all after the first `=`.
+ *      a duplicate key keep all, find() return the first one.
+ */
+class UrlQuery {
+public:
+    static constexpr std::size_t MaxParams = 16;
+    static constexpr std::size_t ArenaSize = 1024;
+
+private:
+    std::string_view path;
+    // only the first paramCount / arenaUsed is valid, not initialize them, it is on every request
+    std::array<UrlQueryParam, MaxParams> params;
+    std::size_t paramCount = 0;
+    std::array<char, ArenaSize> arena;
+    std::size_t arenaUsed = 0;
+
+public:
+    /**
+     * @return error if too many params, the decoded params too long, or a bad percent-encode
+     */
+    error_info parse(std::string_view target);
+
+    /**
+     * @return the path of the target as getPath() after parse() it, but not touch the query
+     */
+    [[nodiscard]]
+    static std::string_view pathOf(std::string_view target);
+
+    /**
+     * the path without the query and the trailing `/`, e.g. `/op`, the root is `/`
+     */
+    [[nodiscard]]
+    std::string_view getPath() const {
+        return path;
+    }
+
+    /**
+     * @return nullptr if not found
+     */
+    [[nodiscard]]
+    const UrlQueryParam *find(std::string_view key) const {
+        for (std::size_t i = 0; i != paramCount; ++i) {
+            if (params[i].key == key) {
+                return &params[i];
+            }
+        }
+        return nullptr;
+    }
+
+    [[nodiscard]]
+    bool empty() const {
+        return paramCount == 0;
+    }
+
+    [[nodiscard]]
+    std::size_t size() const {
+        return paramCount;
+    }
+
+    [[nodiscard]]
+    const UrlQueryParam *begin() const {
+        return params.data();
+    }
+
+    [[nodiscard]]
+    const UrlQueryParam *end() const {
+        return params.data() + paramCount;
+    }
+
+private:
+    /**
+     * decode `in` into the arena, `out` may be `in`
+     * @return false if a bad percent-encode, or out of the arena
+     */
+    bool decode(std::string_view in, std::string_view &out);
+};
+
+
+#endif //VORZECONTROLSERVER_URLQUERY_H
@@ -0,0 +1,85 @@
+/**
+ * VorzeControlServer : A VORZE electric toys Vorze A10 Cyclone/Piston SA Remote Control Adapter Server Powered by Boost.Asio
+ * Copyright (C) 2020 Jeremie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VORZECONTROLSERVER_VERSIONEDDOCUMENT_H
+#define VORZECONTROLSERVER_VERSIONEDDOCUMENT_H
+
+#ifdef MSVC
+#pragma once
+#endif
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/**
+ * a immutable serialized document, and the version of the state it built from
+ */
+struct VersionedDocument {
+    uint64_t version = 0;
+    std::string body;
+    // a quoted HTTP entity tag, unique in this process and across restarts
+    std::string etag;
+};
+
+/**
+ * cache the latest VersionedDocument, it is rebuilt only when the state version changed.
+ *      the readers share the same immutable document, only the std::atomic_load of it take a short spinlock,
+ *      two reader that find it old at same time may both rebuild it, the result is same.
+ */
+class VersionedDocumentCache {
+    // only access it by std::atomic_load/std::atomic_store
+    std::shared_ptr<const VersionedDocument> current;
+    // differ on every run, so a etag cached by a client from the last run never match
+    std::string etagPrefix;
+    std::atomic_size_t builds{0};
+
+public:
+    VersionedDocumentCache();
+
+    /**
+     * @param build     `std::string()` serialize the state, only called if the cached one is not this version
+     */
+    template<typename F>
+    std::shared_ptr<const VersionedDocument> get(uint64_t version, F &&build) {
+        auto d = std::atomic_load(&current);
+        if (d && d->version == version) {
+            return d;
+        }
+        auto n = std::make_shared<VersionedDocument>();
+        n->version = version;
+        n->body = build();
+        n->etag = "\"" + etagPrefix + std::to_string(version) + "\"";
+        builds.fetch_add(1, std::memory_order_relaxed);
+        std::shared_ptr<const VersionedDocument> r{std::move(n)};
+        if (!d || d->version < version) {
+            std::atomic_store(&current, r);
+        }
+        return r;
+    }
+
+    [[nodiscard]]
+    std::size_t getBuilds() const {
+        return builds.load(std::memory_order_relaxed);
+    }
+};
+
+
+#endif //VORZECONTROLSERVER_VERSIONEDDOCUMENT_H
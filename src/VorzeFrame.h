@@ -0,0 +1,94 @@
+/**
+ * VorzeControlServer : A VORZE electric toys Vorze A10 Cyclone/Piston SA Remote Control Adapter Server Powered by Boost.Asio
+ * Copyright (C) 2020 Jeremie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VORZECONTROLSERVER_VORZEFRAME_H
+#define VORZECONTROLSERVER_VORZEFRAME_H
+
+#ifdef MSVC
+#pragma once
+#endif
+
+#include <boost/asio/buffer.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * a command frame send to the VORZE USB Bluetooth Adapter.
+ *      from https://github.com/itfitz/Vorze-PlayerHelper-W
+ *      the frame is `{0x01, 0x01, command}`,
+ *      the command is `(direct ? 0x80 : 0x00) + speed` , speed in [0, 100]
+ */
+struct VorzeFrame {
+    static constexpr std::size_t Size = 3;
+
+    std::array<uint8_t, Size> bytes;
+
+    static constexpr VorzeFrame encode(uint8_t command) {
+        return VorzeFrame{{0x01, 0x01, command}};
+    }
+
+    static constexpr uint8_t encodeStateCommand(bool direct, uint8_t speed) {
+        if (speed > 100) {
+            speed = 100;
+        }
+        return static_cast<uint8_t>((direct ? 0x80 : 0x00) + speed);
+    }
+
+    /**
+     * the pre-encoded frame in VorzeFrameTable, it live in static storage,
+     * so it can be hand to Asio directly without any copy.
+     */
+    static const VorzeFrame &of(uint8_t command);
+
+    static const VorzeFrame &ofState(bool direct, uint8_t speed) {
+        return of(encodeStateCommand(direct, speed));
+    }
+
+    [[nodiscard]]
+    constexpr uint8_t command() const {
+        return bytes[2];
+    }
+
+    [[nodiscard]]
+    boost::asio::const_buffer buffer() const {
+        return boost::asio::buffer(bytes);
+    }
+};
+
+constexpr std::array<VorzeFrame, 256> makeVorzeFrameTable() {
+    std::array<VorzeFrame, 256> t{};
+    for (std::size_t i = 0; i != t.size(); ++i) {
+        t[i] = VorzeFrame::encode(static_cast<uint8_t>(i));
+    }
+    return t;
+}
+
+inline constexpr std::array<VorzeFrame, 256> VorzeFrameTable = makeVorzeFrameTable();
+
+static_assert(VorzeFrameTable[0x80 + 50].bytes[0] == 0x01 &&
+              VorzeFrameTable[0x80 + 50].bytes[1] == 0x01 &&
+              VorzeFrameTable[0x80 + 50].command() == VorzeFrame::encodeStateCommand(true, 50),
+              "VorzeFrameTable encode wrong");
+
+inline const VorzeFrame &VorzeFrame::of(uint8_t command) {
+    return VorzeFrameTable[command];
+}
+
+
+#endif //VORZECONTROLSERVER_VORZEFRAME_H
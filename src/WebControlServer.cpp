@@ -19,10 +19,10 @@
 #include "WebControlServer.h"
 
 
-#include <regex>
 #include <type_traits>
 #include <boost/algorithm/string.hpp>
 #include <boost/lexical_cast.hpp>
+#include "AsyncLogger.h"
 
 std::string HttpConnectSession::createJsonString() {
     boost::property_tree::ptree root;
@@ -62,16 +62,31 @@ std::string HttpConnectSession::createJsonString() {
             boost::property_tree::ptree pPI;
             auto pi = serialPortControlServer->getPortsInfo();
 
-            for (const auto &a : pi) {
+            for (const auto &a : pi->list) {
                 boost::property_tree::ptree n;
 
                 n.put("comName", a.comName);
                 n.put("userFriendlyName", a.userFriendlyName);
+                n.put("vendorId", a.vendorId);
+                n.put("productId", a.productId);
 
                 pPI.push_back(std::make_pair("", n));
             }
 
             root.add_child("portsInfo", pPI);
+
+            // the change of the last port list update
+            auto changes = [](const std::vector<SerialPortNameInfo> &l) {
+                boost::property_tree::ptree p;
+                for (const auto &a : l) {
+                    boost::property_tree::ptree n;
+                    n.put("", a.comName);
+                    p.push_back(std::make_pair("", n));
+                }
+                return p;
+            };
+            root.add_child("portsAdded", changes(pi->added));
+            root.add_child("portsRemoved", changes(pi->removed));
         }
 
         {
@@ -86,6 +101,117 @@ std::string HttpConnectSession::createJsonString() {
 
             root.add_child("OpenPorts", pPN);
         }
+
+        {
+            // the port id of the binary control channel (/ws)
+            boost::property_tree::ptree pIds;
+            for (const auto &a : serialPortControlServer->listOpenPortsName()) {
+                boost::property_tree::ptree n;
+                n.put("comName", a);
+                n.put("portId", serialPortControlServer->getPortId(a));
+                pIds.push_back(std::make_pair("", n));
+            }
+
+            root.add_child("OpenPortIds", pIds);
+        }
+    }
+
+    std::stringstream ss;
+    boost::property_tree::write_json(ss, root);
+    return ss.str();
+}
+
+namespace {
+    LogLine &operator<<(LogLine &l, const UrlQuery &q) {
+        for (const auto &a : q) {
+            l << "\t" << a.key << " = " << a.value;
+        }
+        return l;
+    }
+
+    boost::property_tree::ptree latencyHistogramToPtree(const LatencyHistogram &h) {
+        boost::property_tree::ptree n;
+        n.put("count", h.getCount());
+        n.put("meanUs", h.getMeanUs());
+        n.put("p50Us", h.percentileUs(0.5));
+        n.put("p99Us", h.percentileUs(0.99));
+        n.put("maxUs", h.getMaxUs());
+        return n;
+    }
+}
+
+std::string HttpConnectSession::createStatsJsonString() {
+    boost::property_tree::ptree root;
+
+    if (serialPortControlServer) {
+        boost::property_tree::ptree pSS;
+        auto ss = serialPortControlServer->sessionsSnapshot();
+
+        for (const auto &p : *ss) {
+            const auto &a = p.second;
+            boost::property_tree::ptree n;
+
+            n.put("comName", p.first);
+            n.put("portId", serialPortControlServer->getPortId(p.first));
+
+            auto rs = a->getCommandRingState();
+            boost::property_tree::ptree pRS;
+            pRS.put("capacity", rs.capacity);
+            pRS.put("size", rs.size);
+            pRS.put("highWater", rs.highWater);
+            pRS.put("overflow", rs.overflow);
+            n.add_child("commandRing", pRS);
+
+            n.put("stateFrames", a->getStateFrames());
+            n.put("suppressedFrames", a->getSuppressedFrames());
+            n.put("suppressionRatio", a->getSuppressionRatio());
+            n.put("coalescedFrames", a->getCoalescedFrames());
+            n.put("writtenFrames", a->getWrittenFrames());
+            n.put("writeBatches", a->getWriteBatches());
+            n.put("writeTimeouts", a->getWriteTimeouts());
+            n.put("receivedBytes", a->getReceivedBytes());
+            n.put("deviceEvents", a->getDeviceEvents());
+            n.put("outputLatencyMs", a->getOutputLatencyMs());
+            if (auto as = a->getActionSession()) {
+                boost::property_tree::ptree pAS;
+                pAS.put("syncs", as->getSyncs());
+                pAS.put("seeks", as->getSeeks());
+                pAS.put("lastDriftMs", as->getLastDriftMs());
+                n.add_child("actionSession", pAS);
+            }
+            n.add_child("writeLatency", latencyHistogramToPtree(a->getWriteLatency()));
+            n.add_child("responseLatency", latencyHistogramToPtree(a->getResponseLatency()));
+
+            pSS.push_back(std::make_pair("", n));
+        }
+
+        root.add_child("sessions", pSS);
+
+        boost::property_tree::ptree pGS;
+        auto gs = serialPortControlServer->groupsSnapshot();
+        for (const auto &p : *gs) {
+            const auto &g = p.second;
+            boost::property_tree::ptree n;
+            n.put("name", p.first);
+            boost::property_tree::ptree pM;
+            for (const auto &m : g->getMemberNames()) {
+                boost::property_tree::ptree mn;
+                mn.put("", m);
+                pM.push_back(std::make_pair("", mn));
+            }
+            n.add_child("members", pM);
+            n.put("fanouts", g->getFanouts());
+            n.add_child("skew", latencyHistogramToPtree(g->getSkew()));
+            pGS.push_back(std::make_pair("", n));
+        }
+        root.add_child("groups", pGS);
+    }
+
+    if (statusDocument) {
+        boost::property_tree::ptree pSD;
+        pSD.put("version", serialPortControlServer ? serialPortControlServer->getStateVersion() : 0);
+        pSD.put("builds", statusDocument->getBuilds());
+        root.add_child("statusDocument", pSD);
     }
 
     std::stringstream ss;
@@ -96,6 +222,13 @@ std::string HttpConnectSession::createJsonString() {
 void HttpConnectSession::read_request() {
     auto self = shared_from_this();
 
+    // a fresh message every time, a pipelined request already in buffer_ is parsed from there
+    request_ = {};
+    response_ = {};
+    documentResponse_ = {};
+    document_.reset();
+    check_deadline();
+
     boost::beast::http::async_read(
             socket_,
             buffer_,
@@ -103,14 +236,31 @@ void HttpConnectSession::read_request() {
             [self](boost::beast::error_code ec,
                    std::size_t bytes_transferred) {
                 boost::ignore_unused(bytes_transferred);
-                if (!ec)
-                    self->process_request();
+                if (ec) {
+                    // end_of_stream, the idle timeout, or a bad request
+                    self->close();
+                    return;
+                }
+                self->process_request();
             });
 }
 
 void HttpConnectSession::process_request() {
+    auto target = request_.target();
+    if (UrlQuery::pathOf(std::string_view{target.data(), target.size()}) == "/ws" &&
+        boost::beast::websocket::is_upgrade(request_)) {
+        // the connection become the binary control channel, this session end here
+        deadline_.cancel();
+        std::make_shared<WebSocketControlSession>(
+                std::move(socket_),
+                serialPortControlServer
+        )->start(std::move(request_), std::move(buffer_));
+        return;
+    }
+
     response_.version(request_.version());
-    response_.keep_alive(false);
+    ++requestCount;
+    response_.keep_alive(request_.keep_alive() && requestCount < configLoader->config.controlServerMaxRequests);
 
     if (request_.find(boost::beast::http::field::origin) != request_.end()) {
         auto origin = request_.at(boost::beast::http::field::origin);
@@ -141,7 +291,7 @@ void HttpConnectSession::process_request() {
     write_response();
 }
 
-void HttpConnectSession::path_op(HttpConnectSession::QueryPairsType &queryPairs) {
+void HttpConnectSession::path_op(const UrlQuery &queryPairs) {
     response_.result(boost::beast::http::status::ok);
 
     if (!queryPairs.empty()) {
@@ -154,19 +304,43 @@ void HttpConnectSession::path_op(HttpConnectSession::QueryPairsType &queryPairs)
 
         try {
 
+            auto targetGroup = queryPairs.find("_targetGroup");
+            if (targetMode != nullptr &&
+                targetGroup != nullptr &&
+                targetDirect != nullptr &&
+                targetSpeed != nullptr) {
+                auto direct = boost::lexical_cast<unsigned int>(targetDirect->value.data(), targetDirect->value.size());
+                auto speed = boost::lexical_cast<unsigned int>(targetSpeed->value.data(), targetSpeed->value.size());
+                auto group = serialPortControlServer->getGroup(std::string{targetGroup->value});
+                if (!group) {
+                    response_.result(boost::beast::http::status::not_found);
+                    response_.set(boost::beast::http::field::content_type, "text/plain");
+                    boost::beast::ostream(response_.body()) << "group not found\r\n";
+                    return;
+                }
+                if ((direct != 0 && direct != 1) || speed > 100) {
+                    response_.result(boost::beast::http::status::bad_request);
+                    response_.set(boost::beast::http::field::content_type, "text/plain");
+                    boost::beast::ostream(response_.body()) << "bad direct or speed\r\n";
+                    return;
+                }
+                group->setState(std::string{targetMode->value}, direct == 1, static_cast<uint8_t>(speed));
+                return;
+            }
+
             // TODO
-            if (targetMode != queryPairs.end() &&
-                targetCOM != queryPairs.end() &&
-                targetDirect != queryPairs.end() &&
-                targetSpeed != queryPairs.end()) {
-                auto direct = boost::lexical_cast<uint8_t>(targetDirect->second);
-                auto speed = boost::lexical_cast<uint8_t>(targetSpeed->second);
-                auto comName = targetCOM->second;
-                auto mode = targetMode->second;
+            if (targetMode != nullptr &&
+                targetCOM != nullptr &&
+                targetDirect != nullptr &&
+                targetSpeed != nullptr) {
+                auto direct = boost::lexical_cast<unsigned int>(targetDirect->value.data(), targetDirect->value.size());
+                auto speed = boost::lexical_cast<unsigned int>(targetSpeed->value.data(), targetSpeed->value.size());
+                auto comName = std::string{targetCOM->value};
+                auto mode = std::string{targetMode->value};
 
                 bool directBool = direct == 1;
                 bool directIsValid = direct == 1 || direct == 0;
-                bool speedIsValid = speed >= 0 && speed <= 100;
+                bool speedIsValid = speed <= 100;
 
                 if (!directIsValid || !speedIsValid) {
                     if (!directIsValid) {
@@ -181,7 +355,7 @@ void HttpConnectSession::path_op(HttpConnectSession::QueryPairsType &queryPairs)
                     if (port) {
                         if (port->is_open()) {
                             port->setState(
-                                    mode, directBool, speed,
+                                    mode, directBool, static_cast<uint8_t>(speed),
                                     [](const error_info &ec) {
                                         if (ec) {
                                             // error
@@ -207,12 +381,12 @@ void HttpConnectSession::path_op(HttpConnectSession::QueryPairsType &queryPairs)
             }
 
         } catch (const boost::bad_lexical_cast &e) {
-            std::cout << "boost::bad_lexical_cast:" << e.what() << std::endl;
+            LOG_WARNING << "boost::bad_lexical_cast:" << e.what();
             response_.result(boost::beast::http::status::bad_request);
             response_.set(boost::beast::http::field::content_type, "text/plain");
             boost::beast::ostream(response_.body()) << "boost::bad_lexical_cast:" << e.what() << "\r\n";
         } catch (const std::exception &e) {
-            std::cout << "std::exception:" << e.what() << std::endl;
+            LOG_WARNING << "std::exception:" << e.what();
             response_.result(boost::beast::http::status::bad_request);
             response_.set(boost::beast::http::field::content_type, "text/plain");
             boost::beast::ostream(response_.body()) << "std::exception:" << e.what() << "\r\n";
@@ -220,62 +394,144 @@ void HttpConnectSession::path_op(HttpConnectSession::QueryPairsType &queryPairs)
     }
 }
 
-void HttpConnectSession::create_response() {
-    std::cout << "request_.target():" << request_.target() << std::endl;
-
-    if (request_.target() == "/") {
-        response_.set(boost::beast::http::field::content_type, "text/json");
-        boost::beast::ostream(response_.body())
-                << createJsonString() << "\n";
+void HttpConnectSession::path_sync(const UrlQuery &queryPairs) {
+    auto targetCOM = queryPairs.find("_targetCOM");
+    auto targetGroup = queryPairs.find("_targetGroup");
+    auto targetPosition = queryPairs.find("_position");
+    auto targetRate = queryPairs.find("_rate");
+    if ((targetCOM == nullptr && targetGroup == nullptr) || targetPosition == nullptr) {
+        response_.result(boost::beast::http::status::bad_request);
+        response_.set(boost::beast::http::field::content_type, "text/plain");
+        boost::beast::ostream(response_.body()) << "need _targetCOM (or _targetGroup) and _position\r\n";
         return;
     }
 
-    // from https://github.com/boostorg/beast/issues/787#issuecomment-376259849
-    static const std::regex PARSE_URL{R"((/([^ ?]+)?)?/?\??([^/ ]+\=[^/ ]+)?)",
-                                      std::regex_constants::ECMAScript | std::regex_constants::icase};
-    std::smatch match;
-    auto url = request_.target().to_string();
-    if (std::regex_match(url, match, PARSE_URL) && match.size() == 4) {
-        std::string path = match[1];
-        std::string query = match[3];
-
-        std::vector<std::string> queryList;
-        boost::split(queryList, query, boost::is_any_of("&"));
-
-        HttpConnectSession::QueryPairsType queryPairs;
-        for (const auto &a : queryList) {
-            std::vector<std::string> p;
-            boost::split(p, a, boost::is_any_of("="));
-            if (p.size() == 1) {
-                queryPairs.emplace(p.at(0), "");
-            }
-            if (p.size() == 2) {
-                queryPairs.emplace(p.at(0), p.at(1));
-            }
-            if (p.size() > 2) {
-                std::stringstream ss;
-                for (size_t i = 1; i != p.size(); ++i) {
-                    ss << p.at(i);
-                }
-                queryPairs.emplace(p.at(0), ss.str());
+    try {
+        auto position = boost::lexical_cast<double>(targetPosition->value.data(), targetPosition->value.size());
+        auto rate = targetRate != nullptr
+                    ? boost::lexical_cast<double>(targetRate->value.data(), targetRate->value.size())
+                    : 1.0;
+
+        if (targetGroup != nullptr) {
+            auto group = serialPortControlServer->getGroup(std::string{targetGroup->value});
+            if (!group) {
+                response_.result(boost::beast::http::status::not_found);
+                response_.set(boost::beast::http::field::content_type, "text/plain");
+                boost::beast::ostream(response_.body()) << "group not found\r\n";
+                return;
             }
+            group->syncAction(position, rate);
+            response_.result(boost::beast::http::status::ok);
+            return;
         }
 
-        std::cout << "query:" << query << std::endl;
-        std::cout << "queryList:" << "\n";
-        for (const auto &a : queryList) {
-            std::cout << "\t" << a;
-        }
-        std::cout << std::endl;
-        std::cout << "queryPairs:" << "\n";
-        for (const auto &a : queryPairs) {
-            std::cout << "\t" << a.first << " = " << a.second;
+        auto port = serialPortControlServer->get(std::string{targetCOM->value});
+        if (!port) {
+            response_.result(boost::beast::http::status::not_found);
+            response_.set(boost::beast::http::field::content_type, "text/plain");
+            boost::beast::ostream(response_.body()) << "COM not found\r\n";
+            return;
         }
-        std::cout << std::endl;
+        port->syncAction(position, rate);
+        response_.result(boost::beast::http::status::ok);
+    } catch (const boost::bad_lexical_cast &e) {
+        LOG_WARNING << "boost::bad_lexical_cast:" << e.what();
+        response_.result(boost::beast::http::status::bad_request);
+        response_.set(boost::beast::http::field::content_type, "text/plain");
+        boost::beast::ostream(response_.body()) << "boost::bad_lexical_cast:" << e.what() << "\r\n";
+    }
+}
 
-        if (path == "/op") {
-            return path_op(queryPairs);
-        }
+void HttpConnectSession::path_group(const UrlQuery &queryPairs) {
+    auto name = queryPairs.find("_name");
+    auto members = queryPairs.find("_members");
+    auto remove = queryPairs.find("_remove");
+    response_.set(boost::beast::http::field::content_type, "text/plain");
+    if (name == nullptr) {
+        response_.result(boost::beast::http::status::bad_request);
+        boost::beast::ostream(response_.body()) << "need _name\r\n";
+        return;
+    }
+    if (remove != nullptr) {
+        serialPortControlServer->removeGroup(std::string{name->value});
+        response_.result(boost::beast::http::status::ok);
+        return;
+    }
+    if (members == nullptr) {
+        response_.result(boost::beast::http::status::bad_request);
+        boost::beast::ostream(response_.body()) << "need _members (COM1,COM2,...) or _remove\r\n";
+        return;
+    }
+    std::vector<std::string> memberNames;
+    boost::split(memberNames, members->value, boost::is_any_of(","));
+    memberNames.erase(std::remove(memberNames.begin(), memberNames.end(), std::string{}), memberNames.end());
+    auto r = serialPortControlServer->createGroup(std::string{name->value}, memberNames);
+    if (r.second) {
+        response_.result(boost::beast::http::status::bad_request);
+        boost::beast::ostream(response_.body()) << r.second.message() << "\r\n";
+        return;
+    }
+    response_.result(boost::beast::http::status::ok);
+}
+
+void HttpConnectSession::path_status() {
+    // the config is loaded once, so only the server state change the document
+    auto version = serialPortControlServer ? serialPortControlServer->getStateVersion() : 0;
+    auto d = statusDocument->get(version, [this]() {
+        return createJsonString() + "\n";
+    });
+
+    response_.set(boost::beast::http::field::etag, d->etag);
+    response_.set(boost::beast::http::field::cache_control, "no-cache");
+    auto inm = request_.find(boost::beast::http::field::if_none_match);
+    if (inm != request_.end() &&
+        (inm->value() == "*" || inm->value().find(d->etag) != boost::beast::string_view::npos)) {
+        response_.result(boost::beast::http::status::not_modified);
+        return;
+    }
+
+    response_.set(boost::beast::http::field::content_type, "text/json");
+    // write_response() send it from the cached buffer
+    document_ = std::move(d);
+}
+
+void HttpConnectSession::create_response() {
+    LOG_INFO << "request_.target():" << request_.target();
+
+    // the queryPairs view the target (and its own arena), it must not outlive the request_
+    UrlQuery queryPairs;
+    auto target = request_.target();
+    auto e = queryPairs.parse(std::string_view{target.data(), target.size()});
+    if (e) {
+        response_.result(boost::beast::http::status::bad_request);
+        response_.set(boost::beast::http::field::content_type, "text/plain");
+        boost::beast::ostream(response_.body()) << e.message() << "\r\n";
+        return;
+    }
+
+    // match on the path, so a query (e.g. a cache buster `/?t=1`) not change the route
+    auto path = queryPairs.getPath();
+    if (path == "/") {
+        return path_status();
+    }
+
+    if (path == "/stats") {
+        response_.set(boost::beast::http::field::content_type, "text/json");
+        boost::beast::ostream(response_.body())
+                << createStatsJsonString() << "\n";
+        return;
+    }
+
+    LOG_DEBUG << "queryPairs:" << queryPairs;
+
+    if (path == "/op") {
+        return path_op(queryPairs);
+    }
+    if (path == "/sync") {
+        return path_sync(queryPairs);
+    }
+    if (path == "/group") {
+        return path_group(queryPairs);
     }
 
     response_.result(boost::beast::http::status::not_found);
@@ -287,20 +543,39 @@ void HttpConnectSession::create_response() {
 void HttpConnectSession::write_response() {
     auto self = shared_from_this();
 
-    response_.set(boost::beast::http::field::content_length, response_.body().size());
+    check_deadline();
 
-    boost::beast::http::async_write(
-            socket_,
-            response_,
-            [self](boost::beast::error_code ec, std::size_t) {
-                self->socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_send, ec);
-                self->deadline_.cancel();
-            });
+    auto onWrite = [self, keepAlive = response_.keep_alive()](boost::beast::error_code ec, std::size_t) {
+        if (ec || !keepAlive) {
+            self->close();
+            return;
+        }
+        // keep-alive, the requests are answered one by one in order
+        self->read_request();
+    };
+
+    if (document_) {
+        // the header built in response_, the body is the cached document itself
+        documentResponse_.base() = std::move(response_.base());
+        documentResponse_.body() = {document_->body.data(), document_->body.size()};
+        documentResponse_.content_length(document_->body.size());
+        boost::beast::http::async_write(socket_, documentResponse_, std::move(onWrite));
+        return;
+    }
+
+    // a 304 must not send Content-Length, it would describe the body of the 200 the client cached
+    if (response_.result() != boost::beast::http::status::not_modified) {
+        response_.content_length(response_.body().size());
+    }
+
+    boost::beast::http::async_write(socket_, response_, std::move(onWrite));
 }
 
 void HttpConnectSession::check_deadline() {
     auto self = shared_from_this();
 
+    // re-arm cancel the previous wait
+    deadline_.expires_after(std::chrono::milliseconds{configLoader->config.controlServerIdleTimeoutMs});
     deadline_.async_wait(
             [self](boost::beast::error_code ec) {
                 if (!ec) {
@@ -310,3 +585,8 @@ void HttpConnectSession::check_deadline() {
             });
 }
 
+void HttpConnectSession::close() {
+    boost::beast::error_code ec;
+    socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_send, ec);
+    deadline_.cancel();
+}
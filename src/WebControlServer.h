@@ -31,6 +31,9 @@
 #include <map>
 #include "ConfigLoader.h"
 #include "SerialPortControlServer.h"
+#include "UrlQuery.h"
+#include "WebSocketControlSession.h"
+#include "VersionedDocument.h"
 
 
 // https://www.boost.org/doc/libs/1_73_0/libs/beast/example/http/server/small/http_server_small.cpp
@@ -38,23 +41,32 @@
 class HttpConnectSession : public std::enable_shared_from_this<HttpConnectSession> {
     std::shared_ptr<ConfigLoader> configLoader;
     std::shared_ptr<SerialPortControlServer> serialPortControlServer;
+    // the cached document of `/`, shared by all the connections
+    std::shared_ptr<VersionedDocumentCache> statusDocument;
 
 public:
     HttpConnectSession(boost::asio::ip::tcp::socket socket,
                        std::shared_ptr<ConfigLoader> configLoader,
-                       std::shared_ptr<SerialPortControlServer> serialPortControlServer)
+                       std::shared_ptr<SerialPortControlServer> serialPortControlServer,
+                       std::shared_ptr<VersionedDocumentCache> statusDocument)
             : configLoader(configLoader),
               serialPortControlServer(serialPortControlServer),
+              statusDocument(statusDocument),
               socket_(std::move(socket)) {}
 
     void start() {
         read_request();
-        check_deadline();
     }
 
 protected:
+    // build the document of `/`, only called when the state version changed
     std::string createJsonString();
 
+    // serve the cached document of `/`, or 304 if the client already have this version
+    void path_status();
+
+    std::string createStatsJsonString();
+
 protected:
     // The socket for the currently connected client.
     boost::asio::ip::tcp::socket socket_;
@@ -68,8 +80,17 @@ protected:
     // The response message.
     boost::beast::http::response<boost::beast::http::dynamic_body> response_;
 
-    // The timer for putting a deadline on connection processing.
-    boost::asio::steady_timer deadline_{socket_.get_executor(), std::chrono::seconds(60)};
+    // the cached document of `/` being served, hold until its write completed
+    std::shared_ptr<const VersionedDocument> document_;
+
+    // the response of `/`, its body view the buffer of document_ instead of copy it
+    boost::beast::http::response<boost::beast::http::span_body<const char>> documentResponse_;
+
+    // The timer for putting a deadline on connection processing, it is re-armed on every read and write.
+    boost::asio::steady_timer deadline_{socket_.get_executor()};
+
+    // how many request answered on this connection
+    size_t requestCount = 0;
 
 protected:
     // Asynchronously receive a complete request message.
@@ -84,13 +105,18 @@ protected:
     // Asynchronously transmit the response message.
     void write_response();
 
-    // Check whether we have spent enough time on this connection.
+    // Close the connection if the deadline expired before the next re-arm.
     void check_deadline();
 
+    // Close the connection gracefully, and release the deadline timer.
+    void close();
+
 protected:
-    using QueryPairsType = std::multimap<std::string, std::string>;
+    void path_op(const UrlQuery &queryPairs);
+
+    void path_sync(const UrlQuery &queryPairs);
 
-    void path_op(QueryPairsType &queryPairs);
+    void path_group(const UrlQuery &queryPairs);
 
 };
 
@@ -98,6 +124,7 @@ class WebControlServer : public std::enable_shared_from_this<WebControlServer> {
     boost::asio::executor ex;
     std::shared_ptr<ConfigLoader> configLoader;
     std::shared_ptr<SerialPortControlServer> serialPortControlServer;
+    std::shared_ptr<VersionedDocumentCache> statusDocument = std::make_shared<VersionedDocumentCache>();
 
 public:
 
@@ -139,7 +166,8 @@ private:
                         std::make_shared<HttpConnectSession>(
                                 std::move(socket),
                                 configLoader,
-                                serialPortControlServer
+                                serialPortControlServer,
+                                statusDocument
                         )->start();
                     }
                     if (ec && (
@@ -0,0 +1,176 @@
+/**
+ * VorzeControlServer : A VORZE electric toys Vorze A10 Cyclone/Piston SA Remote Control Adapter Server Powered by Boost.Asio
+ * Copyright (C) 2020 Jeremie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "WebSocketControlSession.h"
+
+#include <sstream>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include "AsyncLogger.h"
+
+void WebSocketControlSession::start(boost::beast::http::request<boost::beast::http::dynamic_body> request,
+                                    boost::beast::flat_buffer buffer) {
+    ws_.set_option(boost::beast::websocket::stream_base::timeout::suggested(boost::beast::role_type::server));
+    ws_.read_message_max(64 * 1024);
+
+    auto self = shared_from_this();
+    // the request (or the handshake bytes) must outlive the accept
+    auto req = std::make_shared<boost::beast::http::request<boost::beast::http::dynamic_body>>(std::move(request));
+    auto handshake = std::make_shared<std::string>();
+    auto onAccept = [self, req, handshake](boost::beast::error_code ec) {
+        if (ec) {
+            LOG_WARNING << "WebSocketControlSession accept error:" << ec.message();
+            return;
+        }
+        // the hello is the first message, no ack can be pending now
+        auto hello = std::make_shared<std::string>(self->createHelloString());
+        self->writing = true;
+        self->ws_.text(true);
+        self->ws_.async_write(boost::asio::buffer(*hello), [self, hello](boost::beast::error_code ec, std::size_t) {
+            self->writing = false;
+            if (ec) {
+                self->closed = true;
+                return;
+            }
+            self->write_acks();
+        });
+        self->read_frame();
+    };
+
+    if (buffer.size() == 0) {
+        ws_.async_accept(*req, std::move(onAccept));
+        return;
+    }
+    // there is no async_accept(request, buffers), so give the accept the request again in front of the rest,
+    // it parse the request and keep the rest in the stream as the first frame bytes
+    std::ostringstream ss;
+    ss << *req;
+    *handshake = ss.str();
+    handshake->append(static_cast<const char *>(buffer.data().data()), buffer.size());
+    ws_.async_accept(boost::asio::buffer(*handshake), std::move(onAccept));
+}
+
+std::string WebSocketControlSession::createHelloString() {
+    boost::property_tree::ptree root;
+    boost::property_tree::ptree pPorts;
+    if (serialPortControlServer) {
+        for (const auto &name : serialPortControlServer->listOpenPortsName()) {
+            boost::property_tree::ptree n;
+            n.put("comName", name);
+            n.put("portId", serialPortControlServer->getPortId(name));
+            pPorts.push_back(std::make_pair("", n));
+        }
+    }
+    root.add_child("ports", pPorts);
+
+    std::stringstream ss;
+    boost::property_tree::write_json(ss, root, false);
+    return ss.str();
+}
+
+void WebSocketControlSession::read_frame() {
+    auto self = shared_from_this();
+    readBuffer_.clear();
+    ws_.async_read(readBuffer_, [self](boost::beast::error_code ec, std::size_t) {
+        if (ec) {
+            // closed by the client, or timeout
+            self->closed = true;
+            return;
+        }
+        auto d = self->readBuffer_.data();
+        self->on_frame(static_cast<const uint8_t *>(d.data()), d.size());
+        self->read_frame();
+    });
+}
+
+void WebSocketControlSession::on_frame(const uint8_t *data, std::size_t size) {
+    WebSocketControlFrame f;
+    WebSocketControlAck ack;
+    if (!ws_.got_binary() || !WebSocketControlFrame::decode(data, size, f)) {
+        ack.status = WebSocketControlStatus::badFrame;
+        push_ack(ack);
+        return;
+    }
+    ack.portId = f.portId;
+    ack.timestamp = f.timestamp;
+
+    auto port = serialPortControlServer ? serialPortControlServer->getById(f.portId) : nullptr;
+    if (!port) {
+        ack.status = WebSocketControlStatus::portNotFound;
+        push_ack(ack);
+        return;
+    }
+    if (f.direct > 1 || f.speed > 100) {
+        ack.status = WebSocketControlStatus::badState;
+        push_ack(ack);
+        return;
+    }
+
+    // called in the executor of the port, back to ws_
+    auto cb = [self = shared_from_this(), ack](const error_info &e) {
+        auto a = ack;
+        a.status = e ? WebSocketControlStatus::sendFail : WebSocketControlStatus::ok;
+        boost::asio::post(self->ws_.get_executor(), [self, a]() {
+            self->push_ack(a);
+        });
+    };
+    if (port->getActionSession()) {
+        // the direct control take over the playing mode
+        port->setState(std::string{"none"}, f.direct == 1, f.speed, cb);
+    } else {
+        port->setState(f.direct == 1, f.speed, std::move(cb));
+    }
+}
+
+void WebSocketControlSession::push_ack(const WebSocketControlAck &ack) {
+    if (closed) {
+        return;
+    }
+    if (pendingAcks.size() == MaxPendingAcks) {
+        return;
+    }
+    pendingAcks.push_back(ack);
+    if (!writing) {
+        write_acks();
+    }
+}
+
+void WebSocketControlSession::write_acks() {
+    if (closed || pendingAcks.empty()) {
+        return;
+    }
+    // all the acks come while the last write go in one message
+    writingBuffer.resize(pendingAcks.size() * WebSocketControlAck::Size);
+    for (std::size_t i = 0; i != pendingAcks.size(); ++i) {
+        pendingAcks[i].encode(writingBuffer.data() + i * WebSocketControlAck::Size);
+    }
+    pendingAcks.clear();
+
+    writing = true;
+    ws_.binary(true);
+    ws_.async_write(
+            boost::asio::buffer(writingBuffer),
+            [self = shared_from_this()](boost::beast::error_code ec, std::size_t) {
+                self->writing = false;
+                if (ec) {
+                    self->closed = true;
+                    return;
+                }
+                self->write_acks();
+            });
+}
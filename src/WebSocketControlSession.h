@@ -0,0 +1,151 @@
+/**
+ * VorzeControlServer : A VORZE electric toys Vorze A10 Cyclone/Piston SA Remote Control Adapter Server Powered by Boost.Asio
+ * Copyright (C) 2020 Jeremie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VORZECONTROLSERVER_WEBSOCKETCONTROLSESSION_H
+#define VORZECONTROLSERVER_WEBSOCKETCONTROLSESSION_H
+
+#ifdef MSVC
+#pragma once
+#endif
+
+#include <boost/asio.hpp>
+#include <boost/beast.hpp>
+#include <boost/beast/websocket.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "SerialPortControlServer.h"
+
+/**
+ * a control frame, a binary message from the client, little endian :
+ *      u16 portId, u8 direct (0/1), u8 speed (0~100) [, u32 timestamp]
+ *      the portId come from the hello message (or `/`), the timestamp is echoed in the ack
+ */
+struct WebSocketControlFrame {
+    static constexpr std::size_t Size = 4;
+    static constexpr std::size_t SizeWithTimestamp = 8;
+
+    uint16_t portId = 0;
+    uint8_t direct = 0;
+    uint8_t speed = 0;
+    uint32_t timestamp = 0;
+
+    /**
+     * @return false if the size is wrong
+     */
+    static bool decode(const uint8_t *p, std::size_t n, WebSocketControlFrame &f) {
+        if (n != Size && n != SizeWithTimestamp) {
+            return false;
+        }
+        f.portId = static_cast<uint16_t>(p[0] | (p[1] << 8));
+        f.direct = p[2];
+        f.speed = p[3];
+        f.timestamp = n == SizeWithTimestamp
+                      ? static_cast<uint32_t>(p[4]) | (static_cast<uint32_t>(p[5]) << 8) |
+                        (static_cast<uint32_t>(p[6]) << 16) | (static_cast<uint32_t>(p[7]) << 24)
+                      : 0;
+        return true;
+    }
+};
+
+enum class WebSocketControlStatus : uint8_t {
+    ok = 0,
+    badFrame = 1,
+    portNotFound = 2,
+    badState = 3,
+    sendFail = 4,
+};
+
+/**
+ * the ack of a control frame, little endian :
+ *      u16 portId, u8 status (WebSocketControlStatus), u8 reserved, u32 timestamp
+ *      a ack message carry one or more ack, in the order the frame completed
+ */
+struct WebSocketControlAck {
+    static constexpr std::size_t Size = 8;
+
+    uint16_t portId = 0;
+    WebSocketControlStatus status = WebSocketControlStatus::ok;
+    uint32_t timestamp = 0;
+
+    void encode(uint8_t *p) const {
+        p[0] = static_cast<uint8_t>(portId);
+        p[1] = static_cast<uint8_t>(portId >> 8);
+        p[2] = static_cast<uint8_t>(status);
+        p[3] = 0;
+        p[4] = static_cast<uint8_t>(timestamp);
+        p[5] = static_cast<uint8_t>(timestamp >> 8);
+        p[6] = static_cast<uint8_t>(timestamp >> 16);
+        p[7] = static_cast<uint8_t>(timestamp >> 24);
+    }
+};
+
+/**
+ * the binary control channel, upgrade from a `GET /ws` of the control server.
+ *      it send a text hello `{"ports":[{"comName":..,"portId":..}]}` first,
+ *      then every control frame go to SerialPortSession::setState directly, and is acked when the port take it.
+ *      the frames are not wait for their ack, a client can stream them at the UI rate.
+ */
+class WebSocketControlSession : public std::enable_shared_from_this<WebSocketControlSession> {
+public:
+    // the acks more than it (a client that never read) are dropped
+    static constexpr std::size_t MaxPendingAcks = 1024;
+
+private:
+    boost::beast::websocket::stream<boost::asio::ip::tcp::socket> ws_;
+    std::shared_ptr<SerialPortControlServer> serialPortControlServer;
+
+    boost::beast::flat_buffer readBuffer_;
+
+    // the state below only touch them in the executor of ws_
+    std::vector<WebSocketControlAck> pendingAcks;
+    std::vector<uint8_t> writingBuffer;
+    bool writing = false;
+    bool closed = false;
+
+public:
+    WebSocketControlSession(boost::asio::ip::tcp::socket socket,
+                            std::shared_ptr<SerialPortControlServer> serialPortControlServer)
+            : ws_(std::move(socket)),
+              serialPortControlServer(serialPortControlServer) {}
+
+    /**
+     * @param request   the upgrade request, already read by the HttpConnectSession
+     * @param buffer    the read buffer of the HttpConnectSession, the bytes after the request
+     *                  (a client may send its first frames before it see the 101) are still in it
+     */
+    void start(boost::beast::http::request<boost::beast::http::dynamic_body> request,
+               boost::beast::flat_buffer buffer);
+
+private:
+    std::string createHelloString();
+
+    void read_frame();
+
+    void on_frame(const uint8_t *data, std::size_t size);
+
+    // called in the executor of ws_
+    void push_ack(const WebSocketControlAck &ack);
+
+    void write_acks();
+};
+
+
+#endif //VORZECONTROLSERVER_WEBSOCKETCONTROLSESSION_H
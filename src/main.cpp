@@ -21,15 +21,21 @@
 #include <boost/beast.hpp>
 #include <boost/format.hpp>
 #include <boost/program_options.hpp>
+#include <boost/filesystem.hpp>
 #include <memory>
 #include <exception>
 #include <regex>
 #include <algorithm>
 #include "ConfigLoader.h"
 #include "WebControlServer.h"
+#include "AsyncLogger.h"
 #include "EmbedWebServer.h"
 #include "SerialPortControlServer.h"
 #include "SerialPortFinder.h"
+#include "Benchmark.h"
+#include "PatternCompiler.h"
+#include "FunscriptConverter.h"
+#include "ActionPatternLibrary.h"
 
 #ifdef USE_BOOST_THEAD
 
@@ -80,11 +86,23 @@ int main1(int argc, const char *argv[]) {
 
 int main(int argc, const char *argv[]) {
     std::string config_file;
+    std::string bench_name;
+    std::vector<std::string> compile_pattern_files;
+    std::string compile_output;
+    long long int compile_ms_per_tick = PatternCompiler::DefaultMsPerTick;
     boost::program_options::options_description desc("options");
     desc.add_options()
             ("config,c", boost::program_options::value<std::string>(&config_file)->
                     default_value(DEFAULT_CONFIG)->
                     value_name("CONFIG"), "specify config file")
+            ("bench", boost::program_options::value<std::string>(&bench_name)->
+                    value_name("NAME"), "run micro benchmark NAME (or `all`) then exit")
+            ("compile-pattern", boost::program_options::value<std::vector<std::string>>(&compile_pattern_files)->
+                    multitoken()->value_name("SCRIPT..."), "compile the pattern scripts (text or .funscript) into a binary pattern library")
+            ("output,o", boost::program_options::value<std::string>(&compile_output)->
+                    value_name("LIBRARY"), "the output binary pattern library of --compile-pattern")
+            ("ms-per-tick", boost::program_options::value<long long int>(&compile_ms_per_tick)->
+                    default_value(PatternCompiler::DefaultMsPerTick), "the default msPerTick of --compile-pattern")
             ("help,h", "print help message")
             ("version,v", "print version and build info");
     boost::program_options::positional_options_description pd;
@@ -121,6 +139,40 @@ int main(int argc, const char *argv[]) {
         return 0;
     }
 
+    if (vMap.count("bench")) {
+        return runBenchmark(bench_name);
+    }
+
+    if (vMap.count("compile-pattern")) {
+        if (compile_output.empty()) {
+            std::cerr << "--compile-pattern need --output LIBRARY" << std::endl;
+            return -1;
+        }
+        std::vector<std::shared_ptr<ActionInfo>> actions;
+        for (const auto &f : compile_pattern_files) {
+            std::pair<std::shared_ptr<ActionInfo>, error_info> r;
+            if (boost::filesystem::path{f}.extension() == ".funscript") {
+                FunscriptConvertOptions o;
+                o.msPerTick = compile_ms_per_tick;
+                r = FunscriptConverter::convertFile(f, o);
+            } else {
+                r = PatternCompiler::compileFile(f, compile_ms_per_tick);
+            }
+            if (r.second) {
+                std::cerr << r.second.message() << std::endl;
+                return -1;
+            }
+            std::cout << f << " -> " << r.first->name << " : " << r.first->ops.size() << " items" << std::endl;
+            actions.push_back(r.first);
+        }
+        auto e = ActionPatternLibrary::write(compile_output, actions);
+        if (e) {
+            std::cerr << e.message() << std::endl;
+            return -1;
+        }
+        return 0;
+    }
+
     std::cout << "config_file: " << config_file << std::endl;
 
     try {
@@ -130,15 +182,20 @@ int main(int argc, const char *argv[]) {
         auto configLoader = std::make_shared<ConfigLoader>();
         configLoader->load(config_file);
         configLoader->print();
+        AsyncLogger::instance().setLevel(parseLogLevel(configLoader->config.logLevel));
 
         boost::asio::executor exSerial = boost::asio::make_strand(ioc);
 
+        // the timing wheel drive all the mode playback, share by all port
+        auto timingWheel = std::make_shared<TimingWheel>(exSerial);
+
         // Action Mode Manager
-        auto actionModeManager = std::make_shared<ActionModeManager>(configLoader);
+        auto actionModeManager = std::make_shared<ActionModeManager>(configLoader, timingWheel);
         actionModeManager->loadActionFromConfig();
 
         // Serial Port Finder
-        auto serialPortFinder = std::make_shared<SerialPortFinder>(ex);
+        auto serialPortFinder = std::make_shared<SerialPortFinder>(
+                ex, configLoader->config.sysfsRoot, configLoader->config.devRoot);
 
         // Serial Port Control Server
         auto serialPortControlServer = std::make_shared<SerialPortControlServer>(